@@ -0,0 +1,183 @@
+#include <Xerus.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+
+
+// Measures how fast the CPU side of rendering records and compiles primitives
+// Draws through the null backend, so no window or GPU is needed and only the CPU is timed
+//
+// Usage: xerus_bench [largest count]
+
+
+using Clock = std::chrono::steady_clock;
+
+
+// Milliseconds between two points in time
+double milliseconds(Clock::time_point start, Clock::time_point end) {
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+// A font whose characters are placeholders, the text is laid out like any bitmap font's
+class BenchFont : public xr::BitmapFont {
+public:
+	BenchFont(const xr::Texture& texture) {
+		// Every printable character gets its own cell of a 16 by 16 grid
+		for (int c = 32; c < 127; c++) {
+			xr::ImageRegion cell = { (c % 16) * 8, (c / 16) * 8, 8, 8, 128, 128 };
+
+			Character character;
+			character.region = xr::TextureRegion(cell, texture);
+			character.size = { 8, 8 };
+			character.offset = { 0, 0 };
+			character.advance = 8;
+
+			this->registerCharacter(char(c), character);
+		}
+	}
+};
+
+
+// A workload records 'count' primitives into a batch
+struct Workload {
+	const char* name;
+	std::function<void(xr::RenderBatch&, int count)> record;
+};
+
+
+// Pseudo-random positions that are the same on every run
+struct Random {
+	uint32_t state = 12345;
+
+	float next(float range) {
+		this->state = this->state * 1664525u + 1013904223u;
+		return (this->state >> 8) * (range / 16777216.0f);
+	}
+};
+
+
+int main(int argc, char** argv) {
+	int largest = argc > 1 ? std::atoi(argv[1]) : 1000000;
+
+	// Never touched by OpenGL, the null backend only looks at their handles,
+	// which have to differ for texture switches to be counted like on a GPU
+	xr::Texture white = xr::Texture::fromHandle(1);
+	xr::Texture glyphs = xr::Texture::fromHandle(2);
+
+	BenchFont font(glyphs);
+
+	xr::Renderer renderer(std::unique_ptr<xr::RenderBackend>(new xr::NullBackend()));
+	glt::mat4f view = glt::orthographic(0.0f, 1000.0f, 1000.0f, 0.0f);
+
+	std::vector<Workload> workloads = {
+		{ "fillRect", [](xr::RenderBatch& batch, int count) {
+			Random random;
+			for (int i = 0; i < count; i++) {
+				batch.fillRect(random.next(1000), random.next(1000), 4, 4);
+			}
+		} },
+
+		// Recorded on the job system, each run of rectangles into the sub-batch of its index
+		{ "fillRect (jobs)", [](xr::RenderBatch& batch, int count) {
+			const int runs = 64;
+			int runSize = (count + runs - 1) / runs;
+
+			xr::JobSystem::get().parallelFor(runs, [&batch, count, runSize](int run) {
+				xr::RenderBatch& subBatch = batch.getSubBatch(run);
+
+				Random random;
+				random.state += run;
+
+				int end = std::min(count, (run + 1) * runSize);
+				for (int i = run * runSize; i < end; i++) {
+					subBatch.fillRect(random.next(1000), random.next(1000), 4, 4);
+				}
+			}, 1);
+		} },
+
+		{ "fillCircle", [](xr::RenderBatch& batch, int count) {
+			Random random;
+			for (int i = 0; i < count; i++) {
+				batch.fillCircle(random.next(1000), random.next(1000), 3.0f);
+			}
+		} },
+
+		{ "fillSmoothCircle", [](xr::RenderBatch& batch, int count) {
+			Random random;
+			for (int i = 0; i < count; i++) {
+				batch.fillSmoothCircle(random.next(1000), random.next(1000), 3.0f);
+			}
+		} },
+
+		{ "drawLine", [](xr::RenderBatch& batch, int count) {
+			Random random;
+			for (int i = 0; i < count; i++) {
+				float x = random.next(1000), y = random.next(1000);
+				batch.drawLine(x, y, x + random.next(20), y + random.next(20), 2);
+			}
+		} },
+
+		// Distinct small concave polygons, so every one has to be triangulated
+		{ "fillPolygon", [](xr::RenderBatch& batch, int count) {
+			Random random;
+			std::vector<glt::vec2f> points(6);
+			for (int i = 0; i < count; i++) {
+				float x = random.next(1000), y = random.next(1000);
+				points[0] = { x, y };
+				points[1] = { x + 8, y };
+				points[2] = { x + 8, y + 8 };
+				points[3] = { x + 4, y + 2 + random.next(4) };
+				points[4] = { x, y + 8 };
+				points[5] = { x - random.next(2), y + 4 };
+				batch.fillPolygon(points);
+			}
+		} },
+
+		// Counted in characters, in lines of 32
+		{ "renderText", [&font](xr::RenderBatch& batch, int count) {
+			std::string line = "The quick brown fox jumps over  ";
+			for (int i = 0; i < count; i += int(line.size())) {
+				font.renderText(line.substr(0, std::min<size_t>(line.size(), count - i)), { 0, i * 0.01f }, &batch);
+			}
+		} },
+	};
+
+	std::printf("%-16s %9s %11s %9s %11s %7s %12s %14s\n",
+				"primitive", "count", "record ms", "ns/prim", "submit ms", "draws", "vertices", "bytes");
+
+	for (const Workload& workload : workloads) {
+		for (int count = 1000; count <= largest; count *= 10) {
+			xr::RenderBatch batch(white);
+
+			// Small counts are repeated for a steadier average
+			int iterations = std::max(1, 100000 / count);
+
+			double recordTime = 0, submitTime = 0;
+			for (int i = 0; i < iterations; i++) {
+				Clock::time_point start = Clock::now();
+				batch.begin(view);
+				workload.record(batch, count);
+				Clock::time_point recorded = Clock::now();
+				renderer.submit(batch, workload.name);
+				renderer.endFrame();
+				Clock::time_point submitted = Clock::now();
+
+				recordTime += milliseconds(start, recorded);
+				submitTime += milliseconds(recorded, submitted);
+			}
+
+			recordTime /= iterations;
+			submitTime /= iterations;
+
+			const xr::FrameStats& stats = renderer.getFrameStats();
+			std::printf("%-16s %9d %11.3f %9.1f %11.3f %7d %12zu %14zu\n",
+						workload.name, count, recordTime, recordTime * 1000000.0 / count, submitTime,
+						stats.drawCalls, stats.vertices, stats.bytesUploaded);
+		}
+	}
+
+	return 0;
+}
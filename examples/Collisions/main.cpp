@@ -17,7 +17,7 @@ xr::WindowPreferences createPreferences() {
 	prefs.contextVersionMinor = 3;
 
 	prefs.vsync = false;
-	prefs.samples = 8;
+	prefs.samples = 0;
 	prefs.fullscreen = false;
 
 	prefs.callbacks.keyPressedCallback = onKeyPressed;
@@ -98,6 +98,8 @@ int main() {
 		
 		renderBatch.setCamera(camera);
 
+		// Smooth edges instead of multisampling
+		renderBatch.setPixelSize(camera.getPixelSize(window->getSize()));
 
 
 		if (window->getMouseButton(GLFW_MOUSE_BUTTON_LEFT)) {
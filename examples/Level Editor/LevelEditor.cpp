@@ -11,6 +11,8 @@ void LevelEditor::setup()
 
 
 	font = TrueTypeFont{"D:/Code/Xerus/examples/Level Editor/res/arial.ttf", 12, true};
+
+	background.reset(new CachedLayer(getWindow().getWidth(), getWindow().getHeight()));
 }
 
 void LevelEditor::update()
@@ -29,30 +31,50 @@ void LevelEditor::update()
 void LevelEditor::render(Renderer & renderer)
 {
 	batch.begin(camera);
+	overlayBatch.begin(camera);
     shadowBatch.begin(camera);
 
-	// Draw background
-	batch.setFillColor(1, 0.4, 0.1);
-	batch.fillRect(camera.screenToWorld({ -1, 1 }), {w / TILE_SIZE, h / TILE_SIZE});
-
-	drawGrid(batch);
-	drawBlocks(batch);
-	drawWalls(batch);
+	// Smooth edges instead of multisampling
+	float pixelSize = camera.getPixelSize(getWindow().getSize());
+	batch.setPixelSize(pixelSize);
+	overlayBatch.setPixelSize(pixelSize);
+
+	// Render the background and grid again only if the camera left them, before the stencil is enabled
+	background->update(renderer, camera, [this](RenderBatch& layer) {
+		const Rectangle<float>& area = background->getBounds();
+		layer.setFillColor(1, 0.4, 0.1);
+		layer.fillRect(area.x, area.y, area.width, area.height);
+		drawGrid(layer, area);
+	});
+
+	background->draw(batch);
+	batch.clearTexture();
+
+	// Upload the blocks and walls again only if they were edited
+	if (terrainChanged) {
+		// Recorded without culling, the camera will move
+		terrainBatch.begin(camera.getTransform());
+		terrainBatch.setPixelSize(pixelSize);
+		drawBlocks(terrainBatch);
+		drawWalls(terrainBatch);
+		terrain.upload(terrainBatch);
+		terrainChanged = false;
+	}
 
 	glt::vec2f lightPosition = camera.screenToWorld(getWindow().windowToScreen(getWindow().getCursorPosition()));
 
 	// Draw the selected tile
-	batch.setFillColor(0.5, 1, 1, 0.5);
-	batch.fillRect(selectedTile, 1);
+	overlayBatch.setFillColor(0.5, 1, 1, 0.5);
+	overlayBatch.fillRect(selectedTile, 1);
 
 	// Draw current selection
 	if (selectionStart) {
 		glt::vec2i tile = mouseToTile(getWindow().getCursorPosition());
 		std::vector<glt::vec2i> tiles = getSelectionTiles(*selectionStart, tile);
 
-		batch.setFillColor(0, 0, 1, 0.5);
+		overlayBatch.setFillColor(0, 0, 1, 0.5);
 		for (auto& t : tiles) {
-			batch.fillRect(t, 1);
+			overlayBatch.fillRect(t, 1);
 		}
 	}
 
@@ -77,20 +99,27 @@ void LevelEditor::render(Renderer & renderer)
 	shadowBatch.setFillColor(shadowDarkness);
 	drawShadows(lightPosition, (w+h) / TILE_SIZE, shadowBatch);
 
-	renderer.submit(shadowBatch);
+	renderer.submit(shadowBatch, "shadows");
 		
 	glStencilFunc(GL_EQUAL, 1, 0xff);
 	glStencilMask(0x00);
 	glColorMask(1, 1, 1, 1);
 	glDepthMask(1);
 
+	// Background, terrain and overlay, in that order
+	auto drawScene = [&]() {
+		renderer.submit(batch, "scene");
+		renderer.submit(terrain, camera.getTransform(), "terrain");
+		renderer.submit(overlayBatch, "overlay");
+	};
+
 	renderer.setColorFilter(glt::vec4f{glt::vec3f{ shadowDarkness }, 1.0 });
-	renderer.submit(batch);
+	drawScene();
 	renderer.setColorFilter({ 1, 1, 1, 1 });
 
 	glStencilFunc(GL_NOTEQUAL, 1, 0xff);
 
-	renderer.submit(batch);
+	drawScene();
 
     glStencilFunc(GL_ALWAYS, 0, 0xff);
 
@@ -132,11 +161,11 @@ void LevelEditor::mousePressed(int button, int x, int y)
 		}
 		else if (getWindow().getKey(GLFW_KEY_LEFT_ALT)) {
 			blocks.erase(tile);
-			walls = generateWalls(blocks);
+			updateWalls();
 		}
 		else {
 			blocks[tile] = Block();
-			walls = generateWalls(blocks);
+			updateWalls();
 		}
 
 	}
@@ -161,7 +190,7 @@ void LevelEditor::mouseReleased(int button, int x, int y)
 				}
 			}
 
-			walls = generateWalls(blocks);
+			updateWalls();
 		}
 
 		delete selectionStart;
@@ -176,6 +205,8 @@ void LevelEditor::windowResized(int width, int height)
 	this->w = width;
 	this->h = height;
 
+	background->resize(width, height);
+
 	float right = w / TILE_SIZE / 2;
 	float bottom = h / TILE_SIZE / 2;
 
@@ -211,22 +242,22 @@ glt::vec2i LevelEditor::mouseToTile(glt::vec2i mouse)
 	return tile;
 }
 
-void LevelEditor::drawGrid(RenderBatch & batch)
+void LevelEditor::drawGrid(RenderBatch & batch, const Rectangle<float>& area)
 {
 	// Set color
 	batch.setFillColor(0.2);
 	float lineWidth = 2 / TILE_SIZE;
 
-	glt::vec2i topLeft = mouseToTile({ 0, 0 });
-	glt::vec2i bottomRight = mouseToTile({static_cast<int>(w), static_cast<int>(h)});
+	float left = area.x, right = area.x + area.width;
+	float top = area.y, bottom = area.y + area.height;
 
 	// Vertical lines
-	for (int x = topLeft.x; x <= bottomRight.x; ++x) {
-		batch.drawLine(x, topLeft.y, x, bottomRight.y + TILE_SIZE, lineWidth);
+	for (int x = int(floorf(left)); x <= int(ceilf(right)); ++x) {
+		batch.drawLine(x, top, x, bottom, lineWidth);
 	}
 	// Horizontal lines
-	for (int y = topLeft.y; y <= bottomRight.y; ++y) {
-		batch.drawLine(topLeft.x, y, bottomRight.x + TILE_SIZE, y, lineWidth);
+	for (int y = int(floorf(top)); y <= int(ceilf(bottom)); ++y) {
+		batch.drawLine(left, y, right, y, lineWidth);
 	}
 }
 
@@ -270,6 +301,34 @@ std::vector<glt::vec2i> LevelEditor::getSelectionTiles(glt::vec2i start, glt::ve
 	return tiles;
 }
 
+void LevelEditor::updateWalls()
+{
+	blocksVersion++;
+	terrainChanged = true;
+
+#if defined(__cpp_impl_coroutine)
+	startAsync(generateWallsAsync(blocks, blocksVersion));
+#else
+	walls = generateWalls(blocks);
+#endif
+}
+
+#if defined(__cpp_impl_coroutine)
+AsyncTask LevelEditor::generateWallsAsync(std::map<glt::vec2i, Block, Compivec2> blocks, int version)
+{
+	// The task owns its copy of the blocks, edits made meanwhile don't touch it
+	std::vector<Wall> generated = co_await onWorker(getScheduler(), [&blocks]() {
+		return generateWalls(blocks);
+	});
+
+	// Back on the game thread, drop the walls if the blocks were edited again
+	if (version == blocksVersion) {
+		walls = std::move(generated);
+		terrainChanged = true;
+	}
+}
+#endif
+
 std::vector<LevelEditor::Wall> LevelEditor::generateWalls(const std::map<glt::vec2i, Block, Compivec2>& blocks)
 {
 	std::vector<Wall> walls;
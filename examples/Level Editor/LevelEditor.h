@@ -29,10 +29,19 @@ public:
 
 
 
+	// The background and grid, only rendered again when the camera leaves it or zooms
+	std::unique_ptr<CachedLayer> background;
+
 	// Render batch
 	RenderBatch batch;
+	RenderBatch overlayBatch;
 	RenderBatch shadowBatch;
 
+	// Blocks and walls, only recorded and uploaded when they change
+	RenderBatch terrainBatch;
+	StaticBatch terrain;
+	bool terrainChanged = true;
+
 	// Camera
 	OrthographicCamera camera;
 
@@ -71,8 +80,8 @@ public:
 	///////////////////////////
 	// Grid ///////////////////
 	///////////////////////////
-	// Renders the grid
-	void drawGrid(RenderBatch& batch);
+	// Renders the grid over an area
+	void drawGrid(RenderBatch& batch, const Rectangle<float>& area);
 
 
 
@@ -128,7 +137,18 @@ public:
 	std::vector<Wall> walls;
 
 	// Generate walls from blocks
-	std::vector <Wall> generateWalls(const std::map<glt::vec2i, Block, Compivec2>& blocks);
+	static std::vector <Wall> generateWalls(const std::map<glt::vec2i, Block, Compivec2>& blocks);
+
+	// Number of edits to the blocks, only the walls of the latest edit are kept
+	int blocksVersion = 0;
+
+	// Generate the walls again after the blocks were edited
+	void updateWalls();
+
+#if defined(__cpp_impl_coroutine)
+	// Generate walls on a worker, keeping the editor responsive while large selections are filled
+	AsyncTask generateWallsAsync(std::map<glt::vec2i, Block, Compivec2> blocks, int version);
+#endif
 
 	// Draw all walls
 	void drawWalls(RenderBatch& batch);
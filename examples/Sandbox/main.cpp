@@ -17,7 +17,7 @@ xr::WindowPreferences createPreferences() {
 	prefs.contextVersionMinor = 3;
 
 	prefs.vsync = false;
-	prefs.samples = 8;
+	prefs.samples = 0;
 	prefs.fullscreen = false;
 
 	prefs.callbacks.keyPressedCallback = onKeyPressed;
@@ -212,6 +212,9 @@ int main() {
 		darkBatch.setCamera(camera);
 		shadowBatch.setCamera(camera);
 
+		// Smooth edges instead of multisampling, shadows only mark the stencil so they stay sharp
+		renderBatch.setPixelSize(camera.getPixelSize(window->getSize()));
+
 
 
 
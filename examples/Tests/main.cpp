@@ -37,7 +37,7 @@ int main() {
 		prefs.contextVersionMinor = 3;
 		
 		prefs.vsync = false;
-		prefs.samples = 8;
+		prefs.samples = 0;
 		prefs.fullscreen = false;
 
 		prefs.callbacks.keyPressedCallback = onKeyPressed;
@@ -65,6 +65,9 @@ int main() {
 		xr::Renderer renderer;
 		xr::RenderBatch renderBatch;
 
+		// Smooth edges instead of multisampling, a unit is a pixel
+		renderBatch.setPixelSize(1);
+
 		xr::Texture texture(atlas);
 		texture.setMinMagFilter(GL_NEAREST, GL_NEAREST);
 
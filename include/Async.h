@@ -0,0 +1,277 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "JobSystem.h"
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#endif
+
+namespace xr {
+
+	// Resumes work waiting for the game loop, once per frame on the game thread
+	// Works without coroutines, they are built on top of it when the compiler supports them, see AsyncTask
+	class AsyncScheduler
+	{
+		// Work waiting for the next update, shared with threads that may finish after the scheduler is gone
+		struct Queue {
+			std::vector<std::function<void()>> ready;
+			std::mutex mutex;
+		};
+
+		std::shared_ptr<Queue> queue;
+
+		// The work being resumed, kept to reuse its storage
+		std::vector<std::function<void()>> resuming;
+
+	public:
+
+		// Schedules work from any thread, dropping it once the scheduler is gone
+		class Remote
+		{
+			friend class AsyncScheduler;
+
+			std::weak_ptr<Queue> queue;
+
+		public:
+
+			// Run work at the scheduler's next update
+			void schedule(std::function<void()> work) const;
+		};
+
+
+		AsyncScheduler();
+
+		AsyncScheduler(const AsyncScheduler&) = delete;
+		AsyncScheduler& operator=(const AsyncScheduler&) = delete;
+
+
+		// Run work at the next update, from any thread
+		void schedule(std::function<void()> work);
+
+		// Return a way to schedule work that is safe to use after the scheduler is gone
+		Remote getRemote() const;
+
+		// Run the work scheduled before the call, work it schedules waits for the next update
+		// Rethrows what the work throws, leaving the rest for the next update
+		void update();
+	};
+
+
+#if defined(__cpp_impl_coroutine)
+
+	// A coroutine run by the game loop, started with startAsync
+	// It runs on the game thread and can wait for the next frame, a job on a worker or work on the context thread
+	// Exceptions it lets through are rethrown by the scheduler's update, and so by the game loop
+	// Tasks still waiting when the game ends are dropped without being resumed
+	class AsyncTask
+	{
+	public:
+
+		struct promise_type {
+			std::exception_ptr error;
+
+			AsyncTask get_return_object() { return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+			// Tasks run once started, then keep their frame until resumed for the last time
+			std::suspend_always initial_suspend() noexcept { return {}; }
+			std::suspend_always final_suspend() noexcept { return {}; }
+
+			void return_void() {}
+			void unhandled_exception() { this->error = std::current_exception(); }
+		};
+
+		typedef std::coroutine_handle<promise_type> Handle;
+
+	private:
+
+		// The coroutine, until it is started
+		Handle handle;
+
+	public:
+
+		explicit AsyncTask(Handle handle) : handle(handle) {}
+
+		AsyncTask(AsyncTask&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+
+		// A task that was never started is dropped
+		~AsyncTask() { if (this->handle) this->handle.destroy(); }
+
+		AsyncTask(const AsyncTask&) = delete;
+		AsyncTask& operator=(const AsyncTask&) = delete;
+		AsyncTask& operator=(AsyncTask&&) = delete;
+
+
+		// Give up ownership of the coroutine
+		Handle release() { return std::exchange(this->handle, nullptr); }
+
+		// Run a coroutine until it waits again, destroying it once it has finished
+		// Rethrows what it let through
+		static void resume(Handle handle)
+		{
+			handle.resume();
+
+			if (handle.done()) {
+				std::exception_ptr error = handle.promise().error;
+				handle.destroy();
+
+				if (error) {
+					std::rethrow_exception(error);
+				}
+			}
+		}
+	};
+
+
+	// Run a task on the calling thread until it first waits, only call from the game thread
+	inline void startAsync(AsyncTask task)
+	{
+		AsyncTask::resume(task.release());
+	}
+
+
+	// Waits for the scheduler's next update
+	class NextFrameAwaiter
+	{
+		AsyncScheduler& scheduler;
+
+	public:
+
+		explicit NextFrameAwaiter(AsyncScheduler& scheduler) : scheduler(scheduler) {}
+
+		bool await_ready() const noexcept { return false; }
+
+		void await_suspend(AsyncTask::Handle handle)
+		{
+			this->scheduler.schedule([handle]() { AsyncTask::resume(handle); });
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+
+	// The result of work run on another thread, or what it threw
+	template <class T>
+	class AsyncResult
+	{
+		std::optional<T> value;
+		std::exception_ptr error;
+
+	public:
+
+		template <class F>
+		void run(F& work)
+		{
+			try {
+				this->value.emplace(work());
+			}
+			catch (...) {
+				this->error = std::current_exception();
+			}
+		}
+
+		T get()
+		{
+			if (this->error) {
+				std::rethrow_exception(this->error);
+			}
+			return std::move(*this->value);
+		}
+	};
+
+	template <>
+	class AsyncResult<void>
+	{
+		std::exception_ptr error;
+
+	public:
+
+		template <class F>
+		void run(F& work)
+		{
+			try {
+				work();
+			}
+			catch (...) {
+				this->error = std::current_exception();
+			}
+		}
+
+		void get()
+		{
+			if (this->error) {
+				std::rethrow_exception(this->error);
+			}
+		}
+	};
+
+
+	// Runs work on another thread, then waits for the scheduler's next update to return its result
+	// 'post' queues a function on the other thread
+	template <class F, class Post>
+	class ThreadAwaiter
+	{
+		typedef std::invoke_result_t<F&> Result;
+
+		AsyncScheduler::Remote scheduler;
+		F work;
+		Post post;
+
+		AsyncResult<Result> result;
+
+	public:
+
+		ThreadAwaiter(AsyncScheduler& scheduler, F work, Post post) :
+			scheduler(scheduler.getRemote()), work(std::move(work)), post(std::move(post))
+		{
+		}
+
+		bool await_ready() const noexcept { return false; }
+
+		// The awaiter lives in the waiting coroutine's frame, which stays put until resumed
+		void await_suspend(AsyncTask::Handle handle)
+		{
+			this->post([this, handle]() {
+				this->result.run(this->work);
+				this->scheduler.schedule([handle]() { AsyncTask::resume(handle); });
+			});
+		}
+
+		Result await_resume() { return this->result.get(); }
+	};
+
+
+	// Wait for the next frame, resumed between update and render
+	inline NextFrameAwaiter nextFrame(AsyncScheduler& scheduler)
+	{
+		return NextFrameAwaiter(scheduler);
+	}
+
+	// Run work on a worker of the shared job system, then return its result at the next update
+	template <class F>
+	auto onWorker(AsyncScheduler& scheduler, F work)
+	{
+		auto post = [](std::function<void()> job) { JobSystem::get().post(std::move(job)); };
+		return ThreadAwaiter<F, decltype(post)>(scheduler, std::move(work), post);
+	}
+
+	// Run work on the thread owning the OpenGL context, then return its result at the next update
+	// Use it to upload textures and buffers while a render thread draws
+	template <class F>
+	auto onContext(AsyncScheduler& scheduler, F work)
+	{
+		auto post = [](std::function<void()> job) { JobSystem::get().runOnContextThread(std::move(job)); };
+		return ThreadAwaiter<F, decltype(post)>(scheduler, std::move(work), post);
+	}
+
+#endif
+
+}
@@ -1,35 +1,206 @@
 #pragma once
 
+#include "Async.h"
+#include "JobSystem.h"
+#include "NullBackend.h"
 #include "Renderer.h"
+#include "RenderThread.h"
 #include "Window.h"
-
+#include "Trace.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <type_traits>
 
 namespace xr {
+
+	// Runs a game's update on a thread of its own, one frame at a time
+	class UpdateThread {
+
+		// Updates the game
+		std::function<void()> update;
+
+		// Has an update been started but not finished
+		bool pending;
+
+		// Set to make the thread stop
+		bool stopping;
+
+		// Thrown by the latest update, rethrown when waiting for it
+		std::exception_ptr error;
+
+		std::mutex mutex;
+		std::condition_variable started;
+		std::condition_variable finished;
+
+		std::thread thread;
+
+	public:
+
+		explicit UpdateThread(std::function<void()> update);
+
+		// Wait for the update in progress and stop
+		~UpdateThread();
+
+		UpdateThread(const UpdateThread&) = delete;
+		UpdateThread& operator=(const UpdateThread&) = delete;
+
+
+		// Start updating the next frame
+		void start();
+
+		// Wait for the update to finish, rethrowing whatever it threw
+		void wait();
+
+	private:
+
+		// Update whenever started, until stopped
+		void run();
+	};
+
+
+	// How a game runs without a window, see BaseGame::startHeadless
+	struct HeadlessPreferences {
+		// Ticks per second, 0 to run them as fast as possible
+		double tickRate = 0;
+
+		// Number of ticks to run, 0 to run until the game stops itself
+		uint64_t ticks = 0;
+
+		// Simulate the same time every tick instead of the time that passed, so runs can be repeated
+		// A tick is 1 / tickRate seconds, or one fixed timestep when unthrottled
+		bool simulatedTime = false;
+
+		// Call render with a renderer that draws nothing, to measure its CPU side as well
+		bool render = true;
+
+		// The size given to windowResized
+		int width = 1280;
+		int height = 720;
+	};
+
+
+	// What a headless run did
+	struct HeadlessStats {
+		// Number of ticks, each an update and a render
+		uint64_t ticks = 0;
+
+		// Time the ticks took in seconds, not counting setup
+		double seconds = 0;
+
+		double ticksPerSecond = 0;
+
+		// Counts of the last rendered frame, as a GL backend would have issued it
+		FrameStats lastFrame;
+	};
+
+
 	class BaseGame {
 
 		// The color to clear the window with
 		glt::vec4f clearColor;
 
-		// The window the game is in
+		// The window the game is in, null when headless
 		Window* window;
 
+		// Is the game running without a window
+		bool headless;
+
+		// Set to end the game after the current frame
+		bool stopped;
+
+		// Are frames drawn on a render thread
+		bool renderThreadEnabled;
+
+		// Does update run on a thread of its own, overlapping render
+		bool pipelined;
+
+
+		// Time between fixed updates in seconds, 0 if there are none
+		double fixedTimestep;
+
+		// Most fixed updates in a frame, time beyond them is dropped
+		int maxFixedSteps;
+
+		// Time not yet simulated by fixed updates
+		double accumulator;
+
+		// When the previous frame was advanced, if any
+		std::chrono::steady_clock::time_point lastAdvance;
+		bool advanced;
+
+		// How far between two fixed updates the latest update left the simulation, and the frame being rendered
+		double updatedInterpolation;
+		double renderedInterpolation;
+
+		// Time simulated by each frame instead of the time that passed, 0 if not simulated
+		double tickTime;
+
+		// Resumes the game's async tasks between update and render
+		AsyncScheduler scheduler;
+
 	protected:
 
 		BaseGame();
 
-		// Return the window the game is in
+		// Return the window the game is in, there is none when headless
 		Window& getWindow();
 
+		// Is the game running without a window, see startHeadless
+		bool isHeadless() const;
+
+		// End the game after the current frame
+		void stop();
+
+		// Return the job system shared by the game and the engine
+		// Work queued for the context thread runs once per frame
+		JobSystem& getJobs();
+
+		// Return the scheduler of the game's async tasks, updated every frame between update and render
+		// With coroutines, start tasks with startAsync and wait in them with nextFrame, onWorker and onContext
+		AsyncScheduler& getScheduler();
+
 
 		// Sets the clear color
 		void setClearColor(float r, float g, float b, float a = 1);
 
+		// Draw frames on a render thread while the next one is updated, call before setup returns
+		// Only setup may create GPU resources then, since the render thread owns the context afterwards
+		void setRenderThreadEnabled(bool enabled);
+
+		// Update the next frame on a thread of its own while the previous one is rendered, call before setup returns
+		// Render has to draw the state of the previous frame, which publish provides, see DoubleBuffered
+		// Update can't use the window then, read input in the event callbacks or in publish instead
+		void setPipelined(bool enabled);
+
+		// Call fixedUpdate every 'timestep' seconds of real time, before each update, 0 to stop
+		// At most 'maxSteps' fixed updates run in a frame, so slow frames slow the simulation down instead of stalling it
+		void setFixedTimestep(double timestep, int maxSteps = 5);
+
+		// Return the time between fixed updates in seconds, 0 if there are none
+		double getFixedTimestep() const;
+
 	public:
 
 		virtual void setup() = 0;
-		virtual void update() = 0;
-		virtual void render(Renderer& renderer) = 0;
+		virtual void update() {}
+		virtual void render(Renderer& renderer) {}
+
+		// Advance the simulation by a fixed time in seconds, see setFixedTimestep
+		virtual void fixedUpdate(double timestep) {}
+
+		// Render a frame 'alpha' of the way from the previous fixed update to the latest one, in [0, 1)
+		// Calls render without it unless overridden
+		virtual void render(Renderer& renderer, double alpha) { this->render(renderer); }
+
+		// Hand the state of a finished update over to render, only called when pipelined
+		// Neither update nor render runs meanwhile
+		virtual void publish() {}
 
 
 		virtual void keyPressed(int key) {}
@@ -47,6 +218,20 @@ namespace xr {
 		// Start and run a new game
 		template <class T>
 		static void start(int width, int height, const char* title);
+
+		// Run a new game without a window or an OpenGL context, for servers and automated tests
+		// The renderer draws nothing, so the game must not create GPU resources or read input, see isHeadless
+		// Render threads are never used, but a pipelined game still updates on a thread of its own
+		template <class T>
+		static HeadlessStats startHeadless(const HeadlessPreferences& prefs = HeadlessPreferences());
+
+	private:
+
+		// Should the game keep running
+		bool isRunning() const;
+
+		// Run the fixed updates that are due, then update
+		void advance();
 	};
 
 	template<class T>
@@ -57,20 +242,27 @@ namespace xr {
 
 		Window* window = nullptr;
 		Renderer* renderer = nullptr;
+		RenderThread* renderThread = nullptr;
 		BaseGame* game = nullptr;
 
 
 		// Create the render operation
 		auto render = [&]() {
 			if (game) {
+				XR_TRACE_SCOPE("BaseGame::render");
+
 				// Clear the screen
 				renderer->clear(game->clearColor);
 
 				// Render the frame
-				game->render(*renderer);
-
-				// Show frame
-				window->swapBuffers();
+				game->render(*renderer, game->renderedInterpolation);
+				renderer->endFrame();
+
+				// The render thread shows its frames itself
+				if (!renderThread) {
+					XR_TRACE_SCOPE("BaseGame::swapBuffers");
+					window->swapBuffers();
+				}
 			}
 		};
 
@@ -81,7 +273,8 @@ namespace xr {
 		prefs.contextVersionMinor = 3;
 
 		prefs.vsync = false;
-		prefs.samples = 8;
+		// Edges are smoothed by the renderer instead, see RenderBatch::setPixelSize
+		prefs.samples = 0;
 		prefs.fullscreen = false;
 
 		// Setup callbacks
@@ -111,23 +304,223 @@ namespace xr {
 		// Tell the game the size of the window right now
 		game->windowResized(window->getWidth(), window->getHeight());
 
-		// Run the game for as long as the window is open
-		while (window->isOpen()) {
-
-			// Create the next frame
-			game->update();
+		// Hand the context over to a render thread, frames are recorded from now on
+		if (game->renderThreadEnabled) {
+			delete renderer;
+			renderThread = new RenderThread(*window);
+			renderer = &renderThread->getRenderer();
+		}
 
-			// Render the next frame
-			render();
+		// Run the game until the window is closed or the game stops
+		if (game->pipelined) {
+			// The first frame has nothing to overlap with
+			game->advance();
+			game->renderedInterpolation = game->updatedInterpolation;
+			game->publish();
+
+			UpdateThread updater([game]() {
+				XR_TRACE_SCOPE("BaseGame::update");
+				game->advance();
+			});
+
+			while (game->isRunning()) {
+
+				XR_TRACE_SCOPE("BaseGame::frame");
+
+				// Create the next frame while rendering the published one
+				updater.start();
+				render();
+
+				{
+					XR_TRACE_SCOPE("BaseGame::waitForUpdate");
+					updater.wait();
+				}
+
+				// Resume async tasks while nothing else touches the game
+				{
+					XR_TRACE_SCOPE("BaseGame::resumeTasks");
+					game->scheduler.update();
+				}
+
+				game->renderedInterpolation = game->updatedInterpolation;
+				game->publish();
+
+				// Poll events, the callbacks never run during an update
+				{
+					XR_TRACE_SCOPE("BaseGame::pollEvents");
+					window->pollEvents();
+				}
+
+				// The render thread runs the context's jobs itself
+				if (!renderThread) {
+					JobSystem::get().runContextJobs();
+				}
+			}
+		}
+		else {
+			while (game->isRunning()) {
+
+				XR_TRACE_SCOPE("BaseGame::frame");
+
+				// Create the next frame
+				{
+					XR_TRACE_SCOPE("BaseGame::update");
+					game->advance();
+					game->renderedInterpolation = game->updatedInterpolation;
+				}
+
+				// Resume async tasks
+				{
+					XR_TRACE_SCOPE("BaseGame::resumeTasks");
+					game->scheduler.update();
+				}
+
+				// Render the next frame
+				render();
+
+				// Poll events
+				{
+					XR_TRACE_SCOPE("BaseGame::pollEvents");
+					window->pollEvents();
+				}
+
+				if (!renderThread) {
+					JobSystem::get().runContextJobs();
+				}
+			}
+		}
 
-			// Poll events
-			window->pollEvents();
+		// Draw the remaining frames before the game's resources go away
+		if (renderThread) {
+			delete renderThread;
+			renderer = nullptr;
 		}
 
 		delete game;
 		delete renderer;
 		delete window;
 	}
+
+	template<class T>
+	inline HeadlessStats BaseGame::startHeadless(const HeadlessPreferences & prefs)
+	{
+		using namespace std::chrono;
+
+		// Make sure we're starting a game and not something else
+		static_assert(std::is_base_of<BaseGame, T>::value, "T must inherit from BaseGame");
+
+		// Draws nothing, so there is no need for a window or a context
+		Renderer renderer(std::unique_ptr<RenderBackend>(new NullBackend()));
+
+		// Call the game through its base, so its overloads aren't hidden by T's
+		std::unique_ptr<T> created(new T());
+		BaseGame* game = created.get();
+		game->headless = true;
+
+		game->setup();
+		game->windowResized(prefs.width, prefs.height);
+
+		// Setup may have chosen the fixed timestep
+		if (prefs.simulatedTime) {
+			game->tickTime = prefs.tickRate > 0 ? 1 / prefs.tickRate : game->fixedTimestep;
+		}
+
+		auto render = [&]() {
+			if (prefs.render) {
+				XR_TRACE_SCOPE("BaseGame::render");
+
+				renderer.clear(game->clearColor);
+				game->render(renderer, game->renderedInterpolation);
+				renderer.endFrame();
+			}
+		};
+
+		// The first frame of a pipelined game has nothing to overlap with
+		std::unique_ptr<UpdateThread> updater;
+		if (game->pipelined) {
+			game->advance();
+			game->renderedInterpolation = game->updatedInterpolation;
+			game->publish();
+
+			updater.reset(new UpdateThread([game]() {
+				XR_TRACE_SCOPE("BaseGame::update");
+				game->advance();
+			}));
+		}
+
+		HeadlessStats stats;
+
+		steady_clock::time_point start = steady_clock::now();
+		steady_clock::time_point nextTick = start;
+		steady_clock::duration tickInterval = prefs.tickRate > 0 ?
+			duration_cast<steady_clock::duration>(duration<double>(1 / prefs.tickRate)) :
+			steady_clock::duration::zero();
+
+		while (game->isRunning() && (prefs.ticks == 0 || stats.ticks < prefs.ticks)) {
+
+			XR_TRACE_SCOPE("BaseGame::frame");
+
+			if (updater) {
+				updater->start();
+				render();
+
+				{
+					XR_TRACE_SCOPE("BaseGame::waitForUpdate");
+					updater->wait();
+				}
+
+				{
+					XR_TRACE_SCOPE("BaseGame::resumeTasks");
+					game->scheduler.update();
+				}
+
+				game->renderedInterpolation = game->updatedInterpolation;
+				game->publish();
+			}
+			else {
+				{
+					XR_TRACE_SCOPE("BaseGame::update");
+					game->advance();
+					game->renderedInterpolation = game->updatedInterpolation;
+				}
+
+				{
+					XR_TRACE_SCOPE("BaseGame::resumeTasks");
+					game->scheduler.update();
+				}
+
+				render();
+			}
+
+			// There is no context, but tasks waiting for it would never resume otherwise
+			JobSystem::get().runContextJobs();
+
+			stats.ticks++;
+
+			// Keep to the tick rate, ticks that ran late aren't caught up on
+			if (prefs.tickRate > 0) {
+				nextTick += tickInterval;
+
+				steady_clock::time_point now = steady_clock::now();
+				if (nextTick > now) {
+					XR_TRACE_SCOPE("BaseGame::waitForTick");
+					std::this_thread::sleep_until(nextTick);
+				}
+				else {
+					nextTick = now;
+				}
+			}
+		}
+
+		stats.seconds = duration<double>(steady_clock::now() - start).count();
+		stats.ticksPerSecond = stats.seconds > 0 ? stats.ticks / stats.seconds : 0;
+		stats.lastFrame = renderer.getFrameStats();
+
+		// The updater refers to the game
+		updater.reset();
+
+		return stats;
+	}
 }
 
 
@@ -18,6 +18,7 @@ namespace xr {
         // Stores information about a character
         struct Character {
             // The texture of the character
+            // Fonts keep all characters in one atlas, so text is drawn with a single texture
             TextureRegion region;
 
             // Size of the character
@@ -2,6 +2,7 @@
 
 #include "Vertex.h"
 
+#include <memory>
 
 
 
@@ -11,8 +12,51 @@ namespace xr {
 		ATTR_POSITION,
 		ATTR_TEX_COORD,
 		ATTR_COLOR,
+
+		// Per-instance attributes of sprites
+		ATTR_SPRITE_POSITION,
+		ATTR_SPRITE_SIZE,
+		ATTR_SPRITE_TEX_REGION,
+		ATTR_SPRITE_COLOR,
+		ATTR_SPRITE_ROTATION,
+		ATTR_SPRITE_LAYER,
+
+		// Per-instance attributes of shapes
+		ATTR_SHAPE_CENTER,
+		ATTR_SHAPE_HALF_SIZE,
+		ATTR_SHAPE_PARAMETERS,
+		ATTR_SHAPE_COLOR,
+
+		// Slot of a draw within a multi-draw, advancing once per instance from the base instance
+		ATTR_DRAW_SLOT,
 	};
 
+
+	// Number of frames a streaming buffer can have in flight
+	const int STREAM_REGION_COUNT = 3;
+
+	// Most vertices a single draw can address with 16-bit indices
+	const GLuint MAX_INDEXED_VERTICES = 65536;
+
+	// Most quads a single draw from the shared quad index buffer can contain
+	const GLuint MAX_QUADS_PER_DRAW = MAX_INDEXED_VERTICES / 4;
+
+	// Number of draw slots a multi-draw can tell apart, the fewest texture units a GL 4.3 fragment shader has
+	const GLuint MAX_DRAW_SLOTS = 16;
+
+
+	// A draw read by glMultiDrawElementsIndirect, laid out as OpenGL expects
+	struct DrawElementsIndirectCommand {
+		GLuint count;
+		GLuint instanceCount;
+		GLuint firstIndex;
+		GLint baseVertex;
+
+		// Selects the draw slot
+		GLuint baseInstance;
+	};
+
+
 	class Buffer {
 
 		// Handle to buffer
@@ -21,6 +65,31 @@ namespace xr {
 		// Buffer type
 		GLenum type;
 
+
+		// Persistently mapped storage of the streaming ring, null if not mapped
+		unsigned char* mappedData;
+
+		// Size of each region in the streaming ring, in bytes
+		GLsizeiptr regionSize;
+
+		// Number of regions in the streaming ring, 0 if not streaming
+		int regionCount;
+
+		// The region currently being written to
+		int currentRegion;
+
+		// Number of bytes written to the current region
+		GLsizeiptr regionOffset;
+
+		// Signaled when the GPU has finished reading from a region
+		std::vector<GLsync> regionFences;
+
+		// Number of bytes streamed since the frame began, counting alignment
+		GLsizeiptr frameBytes;
+
+		// Counts the times the buffer object was replaced
+		unsigned generation;
+
 	public:
 
 		// Create new buffer
@@ -29,24 +98,84 @@ namespace xr {
 		~Buffer();
 
 		// Upload data to buffer
-		void upload(void* data, int length);
+		void upload(void* data, int length, GLenum usage = GL_DYNAMIC_DRAW);
 
 		// Bind this buffer
 		void bind();
+
+		// Return the handle to the buffer
+		GLuint getHandle() const;
+
+		// Return true if the buffer has a streaming ring
+		bool isStreaming() const;
+
+		// Return a number that changes whenever the buffer object is replaced, and with it the handle's meaning
+		// The same handle may come back, so VAOs pointing to the buffer have to compare this instead
+		unsigned getGeneration() const;
+
+
+		// Allocate a streaming ring with a number of regions, each 'size' bytes large
+		void allocateStream(GLsizeiptr size, int regions = STREAM_REGION_COUNT);
+
+		// Make sure 'length' bytes fit in the current region, growing the ring or moving to the next region if not
+		// Data drawn together has to be reserved at once before any of it is streamed,
+		// since growing replaces the buffer and moving on fences the region before its draws are issued
+		void reserve(GLsizeiptr length);
+
+		// Write data into the streaming ring and return its offset in the buffer
+		// The offset is always a multiple of 'alignment'
+		// Reserves room for the data first, which does nothing if it was reserved together with other data
+		GLintptr stream(const void* data, GLsizeiptr length, GLsizeiptr alignment = 1);
+
+		// Fence the current region and move on to the next one,
+		// waiting for the GPU to finish with it if necessary
+		void fence();
+
+		// Fence the frame's streamed data, growing the regions if the frame didn't fit in one
+		// Growing between frames keeps the offsets handed out during the frame valid
+		void endFrame();
+
+	private:
+
+		// Release the streaming ring's storage and fences
+		void releaseStream();
+	};
+
+
+	// Location of streamed geometry in a vertex buffer
+	struct StreamRange {
+		// Index of the first vertex
+		GLint baseVertex;
+
+		// Offset of the first index
+		GLuint firstIndex;
 	};
 
 
+	// Vertices with 16-bit indices
 	class VertexBuffer
 	{
 		// Handle to the VAO
 		GLuint vao;
 
+		// Handle to the VAO drawing quads from the shared quad index buffer
+		GLuint quadVao;
+
 		// Vertex buffer
 		Buffer vbo;
 
 		// Index buffer
 		Buffer ibo;
 
+		// Indices of consecutive quads, shared by all vertex buffers
+		std::shared_ptr<Buffer> quadIbo;
+
+		// The numbers of the draw slots in order, shared by all vertex buffers
+		std::shared_ptr<Buffer> drawSlots;
+
+		// The generations of the buffers the VAOs' attributes currently point to
+		unsigned attachedVbo, attachedIbo;
+
 	public:
 
 		VertexBuffer();
@@ -54,19 +183,117 @@ namespace xr {
 
 
 		// Upload vertices to buffer
-		void upload(const std::vector<Vertex>& vertices);
+		void upload(const std::vector<Vertex>& vertices, GLenum usage = GL_DYNAMIC_DRAW);
 
 		// Upload indices to buffer
-		void upload(const std::vector<GLuint>& indices);
+		void upload(const std::vector<GLushort>& indices, GLenum usage = GL_DYNAMIC_DRAW);
 
 		// Draw the vertices in this buffer
 		void drawElements(GLuint count, GLuint offset, GLenum mode = GL_TRIANGLES);
 
 
+		// Make room for several writes in the streaming rings, so that all of them can be drawn afterwards
+		void reserve(size_t vertices, size_t indices, size_t writes);
+
+		// Write vertices and indices into the streaming ring
+		StreamRange stream(const std::vector<Vertex>& vertices, const std::vector<GLushort>& indices);
+
+		// Draw streamed vertices, indices are relative to 'baseVertex'
+		void drawElements(GLuint count, GLuint offset, GLint baseVertex, GLenum mode = GL_TRIANGLES);
+
+		// Draw quads of four consecutive vertices each, starting at 'firstVertex'
+		// The vertices of a quad are connected as (0, 1, 2) and (2, 3, 0)
+		void drawQuads(GLuint quadCount, GLint firstVertex);
+
+		// Issue several draws with one call, reading 'drawCount' commands at 'offset' in the bound indirect buffer
+		// Quads index the shared quad indices, other draws the streamed ones
+		void multiDrawIndirect(GLintptr offset, GLsizei drawCount, bool quads);
+
+		// Fence this frame's streamed data
+		void endFrame();
+
+
 	private:
 
+		// Point the VAOs' attributes and indices to the current buffers
+		void attachBuffers();
+
+		// Point the attributes of the bound VAO to the vertex buffer
+		void attachAttributes();
 
+		// Return the shared quad index buffer, creating it if no vertex buffer holds it
+		static std::shared_ptr<Buffer> acquireQuadIndices();
+
+		// Return the shared draw slot buffer, creating it if no vertex buffer holds it
+		static std::shared_ptr<Buffer> acquireDrawSlots();
 
 	};
-}
 
+
+	// Describes an attribute that advances once per instance
+	struct InstanceAttribute {
+		// Location in the shader
+		GLuint location;
+
+		// Number of components
+		GLint size;
+
+		// Type of each component
+		GLenum type;
+
+		// Should integer types be normalized to [0, 1]
+		GLboolean normalized;
+
+		// Offset within the instance
+		GLsizei offset;
+	};
+
+
+	// Streams per-instance data and draws instanced primitives
+	class InstanceBuffer
+	{
+		// Handle to the VAO
+		GLuint vao;
+
+		// Instance buffer
+		Buffer buffer;
+
+		// Size of each instance, in bytes
+		GLsizei stride;
+
+		// The layout of an instance
+		std::vector<InstanceAttribute> attributes;
+
+		// The generation of the buffer and the offset the VAO's attributes currently point to
+		unsigned attachedBuffer;
+		GLintptr attachedOffset;
+
+	public:
+
+		InstanceBuffer(GLsizei stride, const std::vector<InstanceAttribute>& attributes);
+		~InstanceBuffer();
+
+
+		// Upload instances to the buffer, replacing any streamed instances
+		void upload(const void* instances, GLsizei count, GLenum usage = GL_DYNAMIC_DRAW);
+
+		// Make room for several writes in the streaming ring, so that all of them can be drawn afterwards
+		void reserve(size_t instances, size_t writes);
+
+		// Write instances into the streaming ring and return their offset in bytes
+		GLintptr stream(const void* instances, GLsizei count);
+
+		// Draw 'count' instances, starting at the byte offset returned by stream
+		void drawInstanced(GLsizei count, GLintptr offset, GLenum mode = GL_TRIANGLE_STRIP, GLsizei vertices = 4);
+
+		// Fence this frame's streamed data
+		void endFrame();
+	};
+
+
+	// Return the layout of a SpriteInstance
+	std::vector<InstanceAttribute> getSpriteInstanceAttributes();
+
+	// Return the layout of a ShapeInstance
+	std::vector<InstanceAttribute> getShapeInstanceAttributes();
+}
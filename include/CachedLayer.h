@@ -0,0 +1,66 @@
+#pragma once
+
+#include "RenderTarget.h"
+#include "RenderBatch.h"
+
+#include <functional>
+
+namespace xr {
+
+	class Renderer;
+
+
+	// Static content rendered once to a texture and drawn as a single quad
+	// The content is only rendered again when invalidated or when the camera moves past the cached margin
+	class CachedLayer
+	{
+		// The rendered content
+		RenderTarget target;
+
+		// Records the content when it has to be rendered
+		RenderBatch batch;
+
+		// The part of the world in the target
+		Rectangle<float> bounds;
+
+		// Size of the camera's view when the content was rendered
+		glt::vec2f viewSize;
+
+		// Fraction of the view rendered beyond each of its edges
+		float margin;
+
+		// Is the rendered content up to date
+		bool valid;
+
+	public:
+
+		// Create a layer for a viewport of a size in pixels,
+		// 'margin' is the fraction of the view rendered beyond each edge, so the camera can move without re-rendering
+		CachedLayer(int viewportWidth, int viewportHeight, float margin = 0.25f);
+
+
+		// Render the content again on the next update
+		void invalidate();
+
+		// Change the size of the viewport, renders the content again on the next update
+		void resize(int viewportWidth, int viewportHeight);
+
+
+		// Render the content by calling 'draw' if it was invalidated, the camera has zoomed
+		// or the camera sees beyond the margin, return true if the content was rendered
+		bool update(Renderer& renderer, const Camera& camera, const std::function<void(RenderBatch&)>& draw);
+
+		// Return the part of the world the content covers, already updated when 'draw' is called
+		const Rectangle<float>& getBounds() const;
+
+		// Draw the rendered content into a batch as a single textured quad
+		// Leaves the batch's texture set to the layer's texture
+		void draw(RenderBatch& batch) const;
+
+	private:
+
+		// Return true if the rendered content covers a view
+		bool covers(const Rectangle<float>& view) const;
+	};
+
+}
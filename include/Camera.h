@@ -1,5 +1,6 @@
 #pragma once
 
+#include "Collision.h"
 
 namespace xr {
 	class Camera
@@ -47,6 +48,13 @@ namespace xr {
 		glt::vec3f screenToWorld(glt::vec2f screen);
 
 
+		// Return the smallest rectangle in the xy-plane containing everything the camera sees
+		Rectangle<float> getViewBounds() const;
+
+		// Return the size of a pixel in world units, given the size of the viewport in pixels
+		float getPixelSize(glt::vec2i viewportSize) const;
+
+
 	private:
 
 		// Update the view matrix
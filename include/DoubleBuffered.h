@@ -0,0 +1,36 @@
+#pragma once
+
+
+namespace xr {
+
+	// Game state written by update and read by render, which may run at the same time when pipelined
+	// Update writes to one copy, publishing copies it to the one render reads
+	template <class T>
+	class DoubleBuffered {
+
+		// The state being updated
+		T current;
+
+		// The state of the latest published frame
+		T published;
+
+	public:
+
+		DoubleBuffered() = default;
+
+		explicit DoubleBuffered(const T& initial)
+			: current(initial), published(initial) {}
+
+
+		// Return the state to update
+		T& write() { return this->current; }
+
+		// Return the state to render
+		const T& read() const { return this->published; }
+
+
+		// Make the updated state the one to render, only call while neither update nor render runs
+		void publish() { this->published = this->current; }
+	};
+
+}
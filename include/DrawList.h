@@ -0,0 +1,107 @@
+#pragma once
+
+#include <cstdint>
+
+#include "Vertex.h"
+#include "Texture.h"
+
+namespace xr {
+
+	// Ways to blend drawn colors with the colors already drawn
+	enum BlendMode {
+		// Blend by the source's alpha
+		BLEND_ALPHA,
+
+		// Add the source, weighted by its alpha
+		BLEND_ADDITIVE,
+
+		// Multiply with the destination
+		BLEND_MULTIPLY,
+
+		// Blend colors that are already multiplied by their alpha, such as the contents of render targets
+		BLEND_PREMULTIPLIED,
+	};
+
+
+	// Kinds of geometry a draw refers to
+	enum DrawType {
+		// Indexed triangles
+		DRAW_MESH,
+
+		// Quads of four consecutive vertices, indexed by the shared quad indices
+		DRAW_QUADS,
+
+		// Sprite instances
+		DRAW_SPRITES,
+
+		// Sprite instances sampling a texture array
+		DRAW_ARRAY_SPRITES,
+
+		// Shape instances, evaluated as signed distance fields
+		DRAW_SHAPES,
+	};
+
+
+	// The draws of a RenderBatch in draw order, with adjacent compatible draws merged
+	// Draws refer to the recorded geometry, which is never copied
+	struct DrawList {
+
+		// A single draw call
+		struct Draw {
+			// The kind of geometry
+			DrawType type;
+
+			// How to blend the geometry
+			BlendMode blend;
+
+			// The texture to sample, for meshes, quads and sprites
+			Texture texture;
+
+			// The texture array to sample, for array sprites
+			TextureArray textureArray;
+
+			// Index of the source holding the geometry
+			GLuint source;
+
+			// Offset of the first index, vertex for quads, sprite or shape
+			GLuint first;
+
+			// Number of indices, vertices for quads, sprites or shapes
+			GLuint count;
+
+			// The vertex that a mesh's indices are relative to
+			GLuint baseVertex;
+		};
+
+
+		// Geometry recorded by one batch
+		struct Source {
+			// Vertices referenced by the indices
+			const std::vector<Vertex>* vertices;
+
+			// Indices of all meshes
+			const std::vector<GLushort>* indices;
+
+			// All sprites
+			const std::vector<SpriteInstance>* sprites;
+
+			// All shapes
+			const std::vector<ShapeInstance>* shapes;
+		};
+
+
+		// Where the draws read their geometry from
+		std::vector<Source> sources;
+
+		// Draws in the order they should be submitted
+		std::vector<Draw> draws;
+
+
+		// Storage for sorting, with the scratch space the sort scatters into
+		std::vector<uint64_t> sortKeys;
+		std::vector<uint32_t> sortValues;
+		std::vector<uint64_t> scratchKeys;
+		std::vector<uint32_t> scratchValues;
+	};
+
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <memory>
+
+#include "Shader.h"
+#include "Vertex.h"
+#include "Buffer.h"
+#include "Texture.h"
+
+#include "RenderBackend.h"
+
+namespace xr {
+
+	// Draws with OpenGL, streaming the geometry of each submit to the GPU
+	class GLBackend : public RenderBackend
+	{
+		// Main shader
+		Shader shader;
+
+		// Shader expanding sprite instances into quads
+		Shader spriteShader;
+
+		// Sprite shader sampling texture arrays
+		Shader arraySpriteShader;
+
+		// Shader evaluating shape instances as signed distance fields
+		Shader shapeShader;
+
+		// Shader sampling a texture per draw slot, null if the context can't multi-draw
+		std::unique_ptr<Shader> multiDrawShader;
+
+		// Vertex buffer
+		VertexBuffer vertexBuffer;
+
+		// Sprite instance buffer
+		InstanceBuffer spriteBuffer;
+
+		// Shape instance buffer
+		InstanceBuffer shapeBuffer;
+
+		// Commands of multi-draws
+		Buffer indirectBuffer;
+
+		// Uniform locations
+		struct UniformLocations {
+			GLuint cameraMatrix;
+			GLuint texture0;
+			GLuint colorFilter;
+			GLuint viewportSize;
+		} uniformLocations, spriteUniformLocations, arraySpriteUniformLocations, shapeUniformLocations, multiDrawUniformLocations;
+
+
+		// Are runs of meshes or quads merged into multi-draws
+		bool multiDraw;
+
+		// The texture of each draw slot in the current multi-draw
+		std::vector<GLuint> slotTextures;
+
+		// Commands of the current multi-draw, reused between multi-draws
+		std::vector<DrawElementsIndirectCommand> indirectCommands;
+
+
+		// Filter color of the current submit
+		glt::vec4f colorFilter;
+
+		// Size of the viewport being drawn to, in pixels
+		glt::vec2f viewportSize;
+
+
+		// The target being drawn to, null for the window
+		RenderTarget* renderTarget;
+
+		// The window's viewport, restored when drawing to the window again
+		GLint windowViewport[4];
+
+
+		// Buffers holding the geometry of draws
+		struct DrawBuffers {
+			VertexBuffer& vertices;
+			InstanceBuffer& sprites;
+			InstanceBuffer& shapes;
+		};
+
+		// Where the geometry of a draw list source starts in the buffers
+		struct SourceLocation {
+			StreamRange range;
+			GLintptr spriteOffset;
+			GLintptr shapeOffset;
+		};
+
+		// Where each source of the draw list was streamed to
+		std::vector<SourceLocation> sourceLocations;
+
+
+		// Counts and times the draws of each frame
+		RenderProfiler profiler;
+
+	public:
+
+		// Compile the shaders and create the buffers, needs a current context
+		GLBackend();
+
+
+		void clear(glt::vec4f color) override;
+
+		void submit(const DrawList& list, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label) override;
+
+		void submit(StaticBatch& batch, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label) override;
+
+		// The viewport covers the whole target
+		void setRenderTarget(RenderTarget* target) override;
+
+		void endFrame() override;
+
+
+		void setGpuTiming(bool enabled) override;
+
+		// The stats are a few frames old, once their GPU timings are known
+		const FrameStats& getFrameStats() const override;
+
+
+		// Merge draws only if the context supports it, on by default where it does
+		void setMultiDraw(bool enabled) override;
+
+		// Return true if the context can merge draws into multi-draws
+		// Needs OpenGL 4.3 and either 4.6 or ARB_shader_draw_parameters, for the draws to index the textures
+		bool supportsMultiDraw() const;
+
+	private:
+
+		// Issue draws reading from the given buffers, 'locations' tell where each source of the draws starts
+		void issueDraws(const std::vector<DrawList::Draw>& draws, const glt::mat4f& transformation,
+						const DrawBuffers& buffers, const SourceLocation* locations);
+
+		// Return the end of the run of draws starting at 'first' that one multi-draw can issue
+		// Leaves the textures of the run in their slots
+		size_t findMultiDrawRun(const std::vector<DrawList::Draw>& draws, size_t first);
+
+		// Issue the draws from 'first' to 'last' with one call, after finding them as a run
+		void issueMultiDraw(const std::vector<DrawList::Draw>& draws, size_t first, size_t last,
+							const DrawBuffers& buffers, const SourceLocation* locations);
+
+		// Find the locations of the uniforms in a shader
+		static UniformLocations getUniformLocations(Shader& shader);
+
+		// Upload the transformation and filters to the shader in use
+		void applyUniforms(const UniformLocations& locations, const glt::mat4f& transformation);
+
+		// Set the blend function of a blend mode
+		static void applyBlendMode(BlendMode mode);
+	};
+
+}
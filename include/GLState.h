@@ -0,0 +1,111 @@
+#pragma once
+
+#include <vector>
+
+namespace xr {
+
+	// Number of state changes since the counters were last reset
+	struct GLStateStats {
+		// Calls passed on to OpenGL
+		int issued = 0;
+
+		// Calls skipped because the state was already set
+		int avoided = 0;
+	};
+
+
+	// Remembers the bindings of an OpenGL context to skip redundant calls
+	// Everything in the engine binds through here, call invalidate after changing bindings directly
+	class GLState {
+
+		// The program in use
+		GLuint program;
+
+		// The bound vertex array
+		GLuint vertexArray;
+
+		// The bound framebuffer
+		GLuint framebuffer;
+
+		// Bound buffers by target, the element array buffer belongs to the bound vertex array
+		std::vector<std::pair<GLenum, GLuint>> buffers;
+
+		// Bound textures by target, for each texture unit
+		std::vector<std::vector<std::pair<GLenum, GLuint>>> textures;
+
+		// The active texture unit
+		GLuint activeTextureUnit;
+
+		// The viewport, queried once if set outside of the engine
+		GLint viewport[4];
+		bool viewportKnown;
+
+		// The blend factors of color and alpha
+		GLenum blendSource, blendDestination;
+		GLenum blendSourceAlpha, blendDestinationAlpha;
+
+		// Counters
+		GLStateStats stats;
+
+	public:
+
+		GLState();
+
+
+		// Return the state of the context that is current on this thread
+		static GLState& get();
+
+
+		// Use a shader program
+		void useProgram(GLuint program);
+
+		// Bind a vertex array
+		void bindVertexArray(GLuint vertexArray);
+
+		// Bind a buffer to a target
+		void bindBuffer(GLenum target, GLuint buffer);
+
+		// Bind a texture to a target of a texture unit and make the unit active
+		void bindTexture(GLenum target, GLuint texture, GLuint unit = 0);
+
+		// Bind a framebuffer for drawing and reading
+		void bindFramebuffer(GLuint framebuffer);
+
+		// Set the viewport
+		void setViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+		// Return the viewport as x, y, width and height, without asking OpenGL unless it is unknown
+		const GLint* getViewport();
+
+		// Set the factors of the blend function, alpha may be blended separately
+		void setBlendFunc(GLenum source, GLenum destination);
+		void setBlendFunc(GLenum source, GLenum destination, GLenum sourceAlpha, GLenum destinationAlpha);
+
+
+		// Forget an object that is about to be deleted, as its name may be reused
+		void forgetProgram(GLuint program);
+		void forgetVertexArray(GLuint vertexArray);
+		void forgetBuffer(GLuint buffer);
+		void forgetTexture(GLuint texture);
+		void forgetFramebuffer(GLuint framebuffer);
+
+		// Forget all bindings, the next call of each kind is always issued
+		void invalidate();
+
+
+		// Return the counters
+		const GLStateStats& getStats() const;
+
+		// Restart the counters from zero
+		void resetStats();
+
+	private:
+
+		// Update a cached binding, return true if the call has to be issued
+		bool change(GLuint& current, GLuint value);
+
+		// Return the cached binding of a target
+		static GLuint& find(std::vector<std::pair<GLenum, GLuint>>& bindings, GLenum target);
+	};
+
+}
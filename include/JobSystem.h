@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xr {
+
+	// Tasks with dependencies between them, run together by a job system
+	// A graph can be run any number of times, but must not have cycles
+	class TaskGraph
+	{
+		friend class JobSystem;
+
+		// A task and the tasks waiting for it
+		struct Node {
+			std::function<void()> work;
+			std::vector<size_t> successors;
+
+			// Number of tasks this one waits for
+			int dependencies = 0;
+
+			// Number of those not yet finished in the current run
+			std::atomic<int> remaining;
+		};
+
+		// Nodes never move, so their counters can be shared between threads
+		std::deque<Node> nodes;
+
+	public:
+
+		// Identifies a task within its graph
+		typedef size_t Task;
+
+
+		// Add a task that runs once all of its dependencies have finished
+		Task add(std::function<void()> work, std::initializer_list<Task> dependencies = {});
+
+		// Make a task wait for another one to finish
+		void addDependency(Task task, Task dependency);
+
+		// Return the number of tasks
+		size_t size() const;
+	};
+
+
+	// Runs tasks on a pool of worker threads, each taking work from the others when it runs out
+	// Threads waiting for tasks run other tasks meanwhile, so waiting from within a task never deadlocks
+	class JobSystem
+	{
+		// Tasks started together, waited for as one
+		struct Batch {
+			// Number of tasks not yet finished
+			std::atomic<int> remaining;
+
+			// Set once a task has thrown, the remaining tasks are skipped
+			std::atomic<bool> failed;
+
+			// The first exception thrown by a task
+			std::exception_ptr error;
+			std::mutex errorMutex;
+		};
+
+		// A function or a task of a graph to run, deleted once run
+		struct Task {
+			std::function<void()> work;
+
+			// The graph and node to run instead, if any
+			TaskGraph* graph;
+			size_t node;
+
+			// The batch the task belongs to, null if posted on its own
+			Batch* batch;
+		};
+
+		// Tasks of a thread, the owner takes the newest and others steal the oldest
+		struct Queue {
+			std::deque<Task*> tasks;
+			std::mutex mutex;
+		};
+
+
+		// The queue of each worker, followed by the one shared by all other threads
+		std::vector<std::unique_ptr<Queue>> queues;
+
+		std::vector<std::thread> workers;
+
+		// Number of tasks in all queues
+		std::atomic<int> queued;
+
+		// Idle workers sleep until tasks are queued
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+		bool stopping;
+
+		// Threads waiting for a batch sleep until tasks are queued or a batch finishes
+		std::condition_variable waiting;
+
+
+		// Work for the thread owning the OpenGL context
+		std::vector<std::function<void()>> contextJobs;
+		std::mutex contextMutex;
+
+	public:
+
+		// Start a number of worker threads, 0 for one less than the number of cores
+		explicit JobSystem(int threads = 0);
+
+		// Finish the queued tasks and stop the workers
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+
+		// Return the job system shared by the engine and games, started on first use
+		static JobSystem& get();
+
+
+		// Return the number of worker threads
+		int getThreadCount() const;
+
+
+		// Call 'work' with every index below 'count' and wait for all calls to finish
+		// Indices are handed out in runs of 'grain', 0 to pick a size from the number of threads
+		// Rethrows the first exception thrown by 'work', once all calls have finished
+		void parallelFor(int count, const std::function<void(int)>& work, int grain = 0);
+
+		// Run every task of a graph, each after its dependencies, and wait for all of them
+		void run(TaskGraph& graph);
+
+		// Run work on the pool without waiting for it, it must not throw
+		void post(std::function<void()> work);
+
+
+		// Queue work for the thread owning the OpenGL context, the game thread unless a render thread draws
+		void runOnContextThread(std::function<void()> work);
+
+		// Run the work queued for the context, only call from the thread owning it
+		void runContextJobs();
+
+	private:
+
+		// Queue a task on the calling worker, or on the shared queue from other threads
+		void push(Task* task);
+
+		// Take a task from the calling thread's queue or steal one, null if there are none
+		Task* take();
+
+		// Run a task if there is one, return false otherwise
+		bool runOne();
+
+		// Run tasks until every task of a batch has finished, then rethrow its first exception
+		// Sleeps when there is nothing to run for a while, instead of spinning while the workers finish
+		void wait(Batch& batch);
+
+		// Schedule the successors of a graph's task that are now ready
+		void finishNode(TaskGraph& graph, size_t node, Batch& batch);
+
+		// Run tasks until stopped
+		void work(size_t queue);
+	};
+
+}
@@ -16,8 +16,8 @@ namespace xr{
 		// List of vertices
 		std::vector<Vertex> vertices;
 
-		// List of indices
-		std::vector<GLuint> indices;
+		// List of indices, relative to the base vertex they are drawn with
+		std::vector<GLushort> indices;
 	};
 }
 
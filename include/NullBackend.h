@@ -0,0 +1,46 @@
+#pragma once
+
+#include "RenderBackend.h"
+
+namespace xr {
+
+	// Draws nothing and needs no context, but counts the calls and bytes a GL backend would issue
+	// Lets the CPU side of rendering be measured on its own, or run where there is no GPU
+	class NullBackend : public RenderBackend
+	{
+		// Counts the work of each frame, never timed
+		RenderProfiler profiler;
+
+		// Number of clears since the backend was created
+		size_t clears;
+
+	public:
+
+		NullBackend();
+
+
+		void clear(glt::vec4f color) override;
+
+		void submit(const DrawList& list, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label) override;
+
+		void submit(StaticBatch& batch, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label) override;
+
+		void setRenderTarget(RenderTarget* target) override;
+
+		void endFrame() override;
+
+
+		// The stats of a frame are known as soon as it ends
+		const FrameStats& getFrameStats() const override;
+
+
+		// Return the number of clears since the backend was created
+		size_t getClearCount() const;
+
+	private:
+
+		// Count the draws a GL backend would issue for a list of draws
+		void countDraws(const std::vector<DrawList::Draw>& draws);
+	};
+
+}
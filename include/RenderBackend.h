@@ -0,0 +1,47 @@
+#pragma once
+
+#include "DrawList.h"
+#include "RenderStats.h"
+
+namespace xr {
+
+	class StaticBatch;
+	class RenderTarget;
+
+
+	// Carries out what the renderer is asked to draw
+	// The renderer compiles batches into draw lists, the backend decides what drawing them means
+	class RenderBackend
+	{
+	public:
+
+		virtual ~RenderBackend() {}
+
+
+		// Clear the target with a color
+		virtual void clear(glt::vec4f color) = 0;
+
+		// Draw a compiled batch, every color is multiplied by the filter
+		virtual void submit(const DrawList& list, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label) = 0;
+
+		// Draw previously uploaded geometry
+		virtual void submit(StaticBatch& batch, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label) = 0;
+
+		// Draw to a render target instead of the window, or to the window again if null
+		virtual void setRenderTarget(RenderTarget* target) = 0;
+
+		// Mark the end of a frame
+		virtual void endFrame() = 0;
+
+
+		// Enable or disable timing submits, if the backend can
+		virtual void setGpuTiming(bool /*enabled*/) {}
+
+		// Enable or disable merging draws into multi-draw calls, if the backend can
+		virtual void setMultiDraw(bool /*enabled*/) {}
+
+		// Return the stats of the latest frame that is complete
+		virtual const FrameStats& getFrameStats() const = 0;
+	};
+
+}
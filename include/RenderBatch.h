@@ -3,50 +3,164 @@
 #include "Mesh.h"
 #include "Texture.h"
 #include "Camera.h"
+#include "DrawList.h"
+#include "Triangulation.h"
+
+#include <memory>
+#include <mutex>
 
 namespace xr {
 
 
-	// Threadsafe render buffer
+	// How draw commands within a layer are ordered
+	enum SortMode {
+		// Draw in the order the commands were recorded
+		SORT_SUBMISSION,
+
+		// Draw by depth, then group by blend mode and texture
+		// Only correct if primitives of equal depth do not overlap
+		SORT_STATE,
+	};
+
+
+	// Number of primitives tested against the view and how many of them were discarded
+	struct CullStats {
+		int tested = 0;
+		int culled = 0;
+	};
+
+
+	// Render buffer, recording draw commands with sort keys
+	// A batch may only be recorded to by one thread at a time,
+	// other threads record to their own sub-batch, see getSubBatch
 	class RenderBatch {
 		friend class Renderer;
 
 
-		struct TextureBatch {
-            // Vertices and indices to draw
-			Mesh mesh;
+		// A range of indices or sprites drawn with the same state
+		struct DrawCommand {
+			// Determines the order the command is drawn in
+			uint64_t key;
+
+			// Is the order part of the key the command's submission index
+			bool sequenced;
+
+			// The range and its state
+			DrawList::Draw draw;
 		};
 
 
-        // Texture batches
-        std::map<Texture, TextureBatch> textureBatches;
+		// Vertices of all meshes and quads, and indices of all meshes
+		Mesh mesh;
+
+		// Sprites of all commands, expanded into quads on the GPU
+		std::vector<SpriteInstance> sprites;
+
+		// Shapes of all commands, expanded into quads on the GPU
+		std::vector<ShapeInstance> shapes;
+
+		// Commands in the order they were recorded
+		std::vector<DrawCommand> commands;
+
 
 		// Current fill color
-		glt::vec4f fillColor;
+		PackedColor fillColor;
 
 		// Current transformation matrix
 		glt::mat4f transformation;
 
-		// Current texture batch
-		TextureBatch* currentTextureBatch;
+		// Current texture
+		Texture currentTexture;
+
+		// Current texture array, only used if 'usingTextureArray' is set
+		TextureArray currentTextureArray;
+		bool usingTextureArray;
+
+		// Current layer of the texture array
+		GLuint currentArrayLayer;
+
+
+		// Current blend mode
+		BlendMode blendMode;
+
+		// Current sort mode
+		SortMode sortMode;
+
+		// Current layer, higher layers are drawn on top
+		int layer;
+
+		// Current depth, only used when sorting by state
+		int depth;
 
 
 		// The default, all white, texture
 		Texture defaultTexture;
 
-		// The region of the current texture to use
-		Rectangle<float> currentTextureRegion;
+		// Texture coordinates of the current texture region's corners,
+		// in the order fillRect emits them
+		PackedTexCoord regionTexCoords[4];
+
+
+		// Is geometry outside of 'viewBounds' discarded
+		bool culling;
+
+		// The area seen by the camera of the current session
+		Rectangle<float> viewBounds;
+
+		// Culling counters of the current session
+		CullStats cullStats;
+
+		// Size of a screen pixel in world units, 0 if edges aren't smoothed
+		float pixelSize;
+
+		// Triangles of recently filled polygons
+		TriangulationCache triangulations;
+
+
+		// Sub-batches by their index, in the order they are drawn
+		std::vector<std::unique_ptr<RenderBatch>> subBatches;
+
+		// Guards the creation of sub-batches
+		std::mutex subBatchMutex;
+
+		// The batch this is a sub-batch of, null if it isn't one
+		RenderBatch* parent;
 
 	public:
 
 		RenderBatch();
 
+		// Create a batch drawing untextured geometry with the given texture
+		// Recording never touches OpenGL, so a batch made with a placeholder texture works without a context
+		explicit RenderBatch(const Texture& defaultTexture);
+
+		RenderBatch(const RenderBatch&) = delete;
+		RenderBatch& operator=(const RenderBatch&) = delete;
 
-		// Start a new drawing session
+
+		// Start a new drawing session, also clearing all sub-batches
+		// Must not be called while other threads are recording
+		// Sessions started from a camera discard primitives the camera can't see
         void begin(const glt::mat4f& transformation);
         void begin(const Camera& camera);
 
 
+		// Enable or disable culling against the view of the camera the session started with
+		void setCulling(bool enabled);
+
+		// Return the culling counters of this session, including all sub-batches
+		CullStats getCullStats() const;
+
+
+		// Return the sub-batch with the given index, creating it on first use, from any thread
+		// Sub-batches share the transformation of this batch and are submitted with it,
+		// within a layer they are drawn after this batch in the order of their index,
+		// so give each job its own index, not each thread, to draw the same way every frame
+		// Recording must have finished on all threads before the batch is submitted
+		// Called on a sub-batch, returns the sub-batch of the batch it belongs to
+		RenderBatch& getSubBatch(size_t index);
+
+
 		// Set the fill color
 		void setFillColor(glt::vec4f color);
 		void setFillColor(glt::vec3f color) { setFillColor(color.x, color.y, color.z); }
@@ -58,11 +172,42 @@ namespace xr {
 		void setTexture(const Texture & texture, const Rectangle<float>& region = { 0.0f, 0.0f, 1.0f, 1.0f });
 		void setTexture(const TextureRegion& region);
 
+		// Sets the current texture to a layer of a texture array
+		// Only fillRect and drawSprite sample texture arrays, they become sprites carrying the layer,
+		// vertices have no room for one so polygons, fans, circles and lines are drawn untextured meanwhile
+		void setTexture(const TextureArray& textureArray, int layer, const Rectangle<float>& region = { 0.0f, 0.0f, 1.0f, 1.0f });
+
 		// Stops rendering with a texture
 		// In reality it switches to an all white texture
 		void clearTexture();
 
 
+		// Set how following primitives are blended
+		void setBlendMode(BlendMode mode);
+
+		// Return the blend mode of new primitives
+		BlendMode getBlendMode() const;
+
+		// Set the layer of following primitives, higher layers are drawn on top of lower ones
+		// Layers range from -32768 to 32767
+		void setLayer(int layer);
+
+		// Set how following primitives are ordered within their layer
+		void setSortMode(SortMode mode);
+
+		// Set the depth of following primitives, lower depths are drawn first
+		// Only used with SORT_STATE, ranges from -8388608 to 8388607
+		void setDepth(int depth);
+
+
+		// Set the size of a screen pixel in world units to smooth the edges of shapes,
+		// removing the need for multisampling, 0 disables smoothing (default)
+		// Untextured rectangles and lines are then drawn as shapes,
+		// polygons, fans and circles get a pixel wide fading outline
+		// Kept between sessions, see Camera::getPixelSize
+		void setPixelSize(float size);
+
+
 		// Draw a filled rectangle
 		void fillRect(float x, float y, float w, float h);
 		void fillRect(float x, float y, float size) { fillRect(x, y, size, size); }
@@ -70,11 +215,21 @@ namespace xr {
 		void fillRect(glt::vec2f pos, glt::vec2f size) { fillRect(pos.x, pos.y, size.x, size.y); }
 
 
-		// Draw a filled polygon
+		// Draw a sprite with the current texture region, rotated around its center
+		void drawSprite(float x, float y, float w, float h, float rotation = 0);
+		void drawSprite(glt::vec2f pos, glt::vec2f size, float rotation = 0) { drawSprite(pos.x, pos.y, size.x, size.y, rotation); }
+
+
+		// Draw a filled polygon, its triangulation is cached so unchanged polygons are only triangulated once
+		// Shapes with more points than 16-bit indices reach are drawn as separate triangles, without smooth edges
 		void fillPolygon(const std::vector<glt::vec2f>& points);
 
+		// Draw a filled polygon with holes cut out of it
+		void fillPolygon(const std::vector<glt::vec2f>& outline, const std::vector<std::vector<glt::vec2f>>& holes);
+
 
 		// Draw a filled triangle fan, first point is the center
+		// Repeat the second point at the end to close the fan, then only its ring gets smooth edges
 		void fillTriangleFan(const std::vector<glt::vec2f>& points);
 
 
@@ -82,19 +237,86 @@ namespace xr {
 		void fillCircle(float x, float y, float r, int segments = 32);
 		void fillCircle(glt::vec2f center, float r, int segments = 32) { fillCircle(center.x, center.y, r, segments); }
 
+		// Draw a filled, untextured circle with smooth edges at any scale
+		void fillSmoothCircle(float x, float y, float r);
+		void fillSmoothCircle(glt::vec2f center, float r) { fillSmoothCircle(center.x, center.y, r); }
+
+
+		// Draw the outline of a circle, 'thickness' extends inwards from the radius
+		void drawRing(float x, float y, float r, float thickness);
+		void drawRing(glt::vec2f center, float r, float thickness) { drawRing(center.x, center.y, r, thickness); }
+
+
+		// Draw a filled rectangle with rounded corners
+		void fillRoundedRect(float x, float y, float w, float h, float radius);
+		void fillRoundedRect(glt::vec2f pos, glt::vec2f size, float radius) { fillRoundedRect(pos.x, pos.y, size.x, size.y, radius); }
+
 
 		// Draw a line
 		void drawLine(float x0, float y0, float x1, float y1, float width = 1);
 		void drawLine(glt::vec2f p1, glt::vec2f p2, float width = 1) { drawLine(p1.x, p1.y, p2.x, p2.y, width); }
 
+		// Draw a line with round caps
+		void drawCapsule(float x0, float y0, float x1, float y1, float width = 1);
+		void drawCapsule(glt::vec2f p1, glt::vec2f p2, float width = 1) { drawCapsule(p1.x, p1.y, p2.x, p2.y, width); }
+
 
 		// Draw a mesh
 		void fillTriangles(const std::vector<glt::vec2f>& points);
 
+
+		// Sort the recorded commands and merge adjacent ones sharing state
+		void compile(DrawList& list) const;
+
 	private:
 
-        // Returns the mesh currently being rendered to
-        Mesh& getCurrentMesh();
+		// Returns false if culling is enabled and the rectangle is outside the view
+		bool isVisible(float x, float y, float w, float h);
+
+		// Returns false if culling is enabled and all points are outside the view
+		bool isVisible(const std::vector<glt::vec2f>& points);
+
+
+        // Returns the mesh to add 'vertexCount' vertices to, ending the current command
+        // if its state differs or its indices can't reach that many more vertices
+        // At most MAX_INDEXED_VERTICES can be added at once, larger shapes go through addTriangleList
+        Mesh& getCurrentMesh(size_t vertexCount);
+
+		// Add separate triangles, three points each, split into meshes that 16-bit indices can reach
+		void addTriangleList(const std::vector<glt::vec2f>& points);
+
+		// Returns the index the next vertex gets in the current mesh command
+		int getStartIndex() const;
+
+		// Adds a quad, drawn as the triangles (a, b, c) and (c, d, a)
+		void addQuad(const Vertex& a, const Vertex& b, const Vertex& c, const Vertex& d);
+
+		// Returns true if edges should be smoothed
+		bool isSmoothing() const { return this->pixelSize > 0; }
+
+		// Adds a pixel wide outline fading out around 'count' vertices of the current mesh command,
+		// starting at index 'first', space for as many new vertices has to be reserved
+		// The outline of a hole fades out towards its inside
+		void addFringe(int first, int count, bool hole = false);
+
+		// Adds a rounded box around a center, culled by its bounding circle
+		void addShape(glt::vec2f center, glt::vec2f halfSize, float rotation, float radius, float thickness);
+
+		// Returns the command primitives of a type should be added to,
+		// recording a new one if the current command's state differs
+		DrawCommand& getCommand(DrawType type, size_t vertexCount = 0);
+
+		// Returns the number of indices, vertices or sprites in a command
+		GLuint getCommandCount(size_t index) const;
+
+		// Returns the number of indices, vertices or sprites the commands of a type index into
+		size_t getEnd(DrawType type) const;
+
+		// Returns this batch for index 0, otherwise one of its sub-batches
+		const RenderBatch& getBatch(size_t index) const;
+
+		// Sets the region of the current texture to use
+		void setTextureRegion(const Rectangle<float>& region);
 
 	};
 
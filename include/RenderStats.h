@@ -0,0 +1,175 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xr {
+
+	// Draws in a row sampling the same texture
+	struct TextureBatchStats {
+		// Handle of the texture or texture array, 0 for a multi-draw sampling several
+		GLuint texture = 0;
+
+		// Number of draw calls
+		int drawCalls = 0;
+
+		// Time the GPU spent on the draws, in milliseconds
+		double gpuTime = 0;
+	};
+
+
+	// A single submit to the renderer
+	struct SubmitStats {
+		// Name given to the submit, empty if none
+		// Copied, stats are read after the frame and maybe on another thread than the one that submitted
+		std::string label;
+
+		// Number of draw calls
+		int drawCalls = 0;
+
+		// Time the GPU spent on the submit, in milliseconds
+		double gpuTime = 0;
+
+		// The runs of draws sampling the same texture, in order
+		std::vector<TextureBatchStats> textureBatches;
+	};
+
+
+	// Everything the renderer did during a frame
+	struct FrameStats {
+		// Number of the frame, counted from the first one
+		uint64_t frame = 0;
+
+		// Number of submits
+		int submits = 0;
+
+		// Number of draw calls
+		int drawCalls = 0;
+
+		// Number of draws issued as commands of multi-draw calls, each call counts once in 'drawCalls'
+		int multiDrawCommands = 0;
+
+		// Number of vertices streamed
+		size_t vertices = 0;
+
+		// Number of indices drawn
+		size_t indices = 0;
+
+		// Number of sprite and shape instances drawn
+		size_t instances = 0;
+
+		// Number of bytes written to GPU buffers
+		size_t bytesUploaded = 0;
+
+		// Number of times the texture changed between draws
+		int textureSwitches = 0;
+
+		// Number of times the shader changed between draws
+		int shaderSwitches = 0;
+
+		// Time the GPU spent on all submits, in milliseconds, 0 if not timed
+		double gpuTime = 0;
+
+		// Each submit in order
+		std::vector<SubmitStats> submitStats;
+	};
+
+
+	// Number of frames whose GPU timings can be waiting at once
+	const int PROFILER_FRAME_COUNT = 4;
+
+
+	// Counts what the renderer does and times it on the GPU with timestamp queries
+	// The timestamps are read back a few frames later, so the GPU never has to be waited for
+	class RenderProfiler
+	{
+		// A frame being recorded or waiting for its timestamps
+		struct Frame {
+			// The counters and timings
+			FrameStats stats;
+
+			// Timestamp queries, reused between frames
+			std::vector<GLuint> queries;
+
+			// Number of queries issued this frame
+			size_t queryCount = 0;
+
+			// Index of the query issued at the start of each submit
+			// It is followed by one query per texture batch and one at the end of the submit
+			std::vector<size_t> submitQueries;
+
+			// Are timestamps waiting to be read
+			bool pending = false;
+		};
+
+
+		// Frames in a ring, the current one is being recorded
+		Frame frames[PROFILER_FRAME_COUNT];
+		int currentFrame;
+
+		// Number of the frame being recorded
+		uint64_t frameNumber;
+
+		// The latest frame whose timings are known
+		FrameStats latest;
+
+		// The texture of the latest texture batch
+		GLuint lastTexture;
+
+		// Are draws timed on the GPU
+		bool timing;
+
+		// Is the current submit timed
+		bool submitTimed;
+
+	public:
+
+		RenderProfiler();
+		~RenderProfiler();
+
+		RenderProfiler(const RenderProfiler&) = delete;
+		RenderProfiler& operator=(const RenderProfiler&) = delete;
+
+
+		// Enable or disable timing on the GPU, counters are always kept
+		void setTiming(bool enabled);
+
+
+		// Mark the start and end of a submit
+		void beginSubmit(const char* label);
+		void endSubmit();
+
+		// Mark the start of draws sampling a texture
+		void beginTextureBatch(GLuint texture);
+
+		// Count a draw call
+		void countDraw(size_t indices, size_t instances);
+
+		// Count a multi-draw call made of several commands
+		void countMultiDraw(size_t indices, int commands);
+
+		// Count geometry written to GPU buffers
+		void countUpload(size_t vertices, size_t bytes);
+
+		// Count a change of shader
+		void countShaderSwitch();
+
+
+		// Finish the current frame and read back the timings of earlier frames that are ready
+		void endFrame();
+
+		// Return the stats of the latest frame whose timings have been read back
+		const FrameStats& getFrameStats() const;
+
+	private:
+
+		// Write the GPU's time into the next query of the current frame
+		void timestamp();
+
+		// Read the timestamps of a frame and publish its stats, waiting for them if 'wait' is set
+		// Return true if the frame was resolved
+		bool resolve(Frame& frame, bool wait);
+	};
+
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Texture.h"
+
+namespace xr {
+
+	// A texture that can be drawn to, through a framebuffer object
+	// Alpha blending leaves colors multiplied by their alpha, draw the texture with BLEND_PREMULTIPLIED
+	class RenderTarget
+	{
+		// Handle to the framebuffer
+		GLuint framebuffer;
+
+		// Handle to the depth and stencil renderbuffer
+		GLuint depthStencil;
+
+		// The color attachment
+		Texture texture;
+
+		// Size in pixels
+		int width, height;
+
+	public:
+
+		// Create a new render target of a size in pixels
+		RenderTarget(int width, int height);
+
+		~RenderTarget();
+
+		RenderTarget(const RenderTarget&) = delete;
+		RenderTarget& operator=(const RenderTarget&) = delete;
+
+
+		// Replace the attachments with ones of a new size, discarding the contents
+		void resize(int width, int height);
+
+		// Bind the framebuffer
+		void bind();
+
+		// Bind the window's framebuffer
+		static void bindDefault();
+
+
+		// Return the texture drawn to
+		const Texture& getTexture() const;
+
+		// Return the size in pixels
+		int getWidth() const;
+		int getHeight() const;
+
+	private:
+
+		// Create the attachments and attach them to the framebuffer
+		void createAttachments();
+
+		// Delete the attachments
+		void releaseAttachments();
+	};
+
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "Renderer.h"
+#include "Window.h"
+
+namespace xr {
+
+	// Most frames that can be recorded but not yet drawn
+	const int MAX_RENDER_THREAD_FRAMES = 3;
+
+
+	// Everything drawn during a frame, recorded on one thread and replayed on another
+	// Geometry is copied, so batches can go away as soon as they are submitted
+	// Static batches and render targets are referred to and have to outlive the frame, labels are copied
+	class FramePacket
+	{
+		// Kinds of recorded calls
+		enum CommandType {
+			COMMAND_CLEAR,
+			COMMAND_SUBMIT,
+			COMMAND_SUBMIT_STATIC,
+			COMMAND_SET_RENDER_TARGET,
+			COMMAND_SET_GPU_TIMING,
+			COMMAND_SET_MULTI_DRAW,
+		};
+
+		// A recorded call to the backend
+		struct Command {
+			CommandType type;
+
+			// Clear color or color filter
+			glt::vec4f color;
+
+			glt::mat4f transformation;
+			std::string label;
+
+			// Index of the draw list of a submit
+			size_t list;
+
+			StaticBatch* staticBatch;
+			RenderTarget* target;
+			bool enabled;
+		};
+
+		// Copy of the geometry of a draw list source
+		struct Geometry {
+			std::vector<Vertex> vertices;
+			std::vector<GLushort> indices;
+			std::vector<SpriteInstance> sprites;
+			std::vector<ShapeInstance> shapes;
+		};
+
+
+		// The calls in order
+		std::vector<Command> commands;
+
+		// Draw lists of the submits, pointing to the copied geometry
+		// Both are reused between frames and never move, so the pointers stay valid
+		std::deque<DrawList> lists;
+		std::deque<Geometry> geometry;
+
+		// Number of lists and geometry used this frame
+		size_t listCount;
+		size_t geometryCount;
+
+	public:
+
+		// Size of the window when the frame was recorded
+		glt::vec2i windowSize;
+
+		// Was vertical sync enabled when the frame was recorded
+		bool verticalSync;
+
+
+		FramePacket();
+
+
+		// Forget the recorded calls, keeping the storage
+		void reset();
+
+
+		// Record calls to a backend
+		void clear(glt::vec4f color);
+		void submit(const DrawList& list, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label);
+		void submit(StaticBatch& batch, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label);
+		void setRenderTarget(RenderTarget* target);
+		void setGpuTiming(bool enabled);
+		void setMultiDraw(bool enabled);
+
+
+		// Issue the recorded calls to a backend, without ending the frame
+		void replay(RenderBackend& backend) const;
+	};
+
+
+	class RenderThread;
+
+	// Records the calls of a renderer into the render thread's frames
+	class FrameRecorder : public RenderBackend
+	{
+		// The thread the frames go to
+		RenderThread& thread;
+
+		// The stats of the latest frame the render thread has read back
+		FrameStats stats;
+
+	public:
+
+		explicit FrameRecorder(RenderThread& thread);
+
+
+		void clear(glt::vec4f color) override;
+
+		void submit(const DrawList& list, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label) override;
+
+		void submit(StaticBatch& batch, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label) override;
+
+		void setRenderTarget(RenderTarget* target) override;
+
+		// Hand the frame to the render thread, waiting if it is a full set of frames behind
+		void endFrame() override;
+
+
+		void setGpuTiming(bool enabled) override;
+
+		void setMultiDraw(bool enabled) override;
+
+		// The stats are a few frames older than on the render thread
+		const FrameStats& getFrameStats() const override;
+	};
+
+
+	// Draws and presents frames on a thread of its own, which owns the window's context
+	// The game thread records the next frame while the previous one is drawn and the buffers are swapped
+	// While running, no other thread may use the context, so GPU resources have to be created before it starts
+	class RenderThread
+	{
+		friend class FrameRecorder;
+
+		// The window being drawn to
+		Window& window;
+
+		// Frames in a ring, the next one to record follows the ones waiting to be drawn
+		FramePacket frames[MAX_RENDER_THREAD_FRAMES];
+		int frameCount;
+
+		// Number of frames handed to the render thread and drawn by it, only change with the lock held
+		uint64_t framesRecorded;
+		uint64_t framesDrawn;
+
+		// Set to make the render thread finish the frames it has and stop
+		bool stopping;
+
+		// The stats of the latest frame read back by the backend
+		FrameStats latestStats;
+
+		std::mutex mutex;
+		std::condition_variable frameRecorded;
+		std::condition_variable frameDrawn;
+
+		// Renderer recording frames, used on the game thread
+		std::unique_ptr<Renderer> renderer;
+
+		std::thread thread;
+
+	public:
+
+		// Take over the window's context, which has to be current on the calling thread
+		// Up to 'frames' frames can be waiting to be drawn, the game waits for the render thread beyond that
+		explicit RenderThread(Window& window, int frames = 2);
+
+		// Draw the remaining frames, stop and make the context current on the calling thread again
+		~RenderThread();
+
+		RenderThread(const RenderThread&) = delete;
+		RenderThread& operator=(const RenderThread&) = delete;
+
+
+		// Return the renderer recording frames, only use it on the thread that created the render thread
+		Renderer& getRenderer();
+
+	private:
+
+		// Return the frame being recorded
+		FramePacket& recordingFrame();
+
+		// Hand the recorded frame to the render thread and start the next one
+		void finishFrame();
+
+		// Draw frames until stopped
+		void run();
+	};
+
+}
@@ -1,4 +1,6 @@
 #pragma once
+#include <memory>
+
 #include "Shader.h"
 #include "Vertex.h"
 #include "Buffer.h"
@@ -7,46 +9,80 @@
 #include "Mesh.h"
 
 #include "RenderBatch.h"
+#include "StaticBatch.h"
+#include "RenderTarget.h"
+#include "RenderStats.h"
+#include "RenderBackend.h"
 
 namespace xr {
 
 
 	class Renderer
 	{
-		// Main shader
-		Shader shader;
-
-		// Vertex buffer
-		VertexBuffer vertexBuffer;
-
-		// Uniform locations
-		struct UniformLocations {
-			GLuint cameraMatrix;
-			GLuint texture0;
-			GLuint colorFilter;
-		} uniformLocations;
+		// Draws the compiled batches
+		std::unique_ptr<RenderBackend> backend;
 
+		// The sorted commands of the batch being submitted, reused between batches
+		DrawList drawList;
 
 		// Filter color
 		glt::vec4f colorFilter;
 
+		// The target being drawn to, null for the window
+		RenderTarget* renderTarget;
+
 	public:
 
-		// Create a new renderer
+		// Create a new renderer drawing with OpenGL
 		Renderer();
 
+		// Create a renderer drawing with another backend
+		explicit Renderer(std::unique_ptr<RenderBackend> backend);
+
 
 		// Clear color and depth buffer
 		void clear(float r, float g, float b, float a);
 		void clear(glt::vec4f color) { this->clear(color.r, color.g, color.b, color.a); }
 
 
-		// Submit a batch to the renderer
-		void submit(const RenderBatch& batch);
+		// Submit a batch to the renderer, the label names the submit in the frame's stats
+		void submit(const RenderBatch& batch, const char* label = nullptr);
+
+		// Draw previously uploaded geometry with a transformation
+		void submit(StaticBatch& batch, const glt::mat4f& transformation, const char* label = nullptr);
+
+		// Mark the end of a frame, call before swapping buffers
+		void endFrame();
+
+
+		// Enable or disable timing submits on the GPU
+		void setGpuTiming(bool enabled);
+
+		// Enable or disable merging runs of meshes and quads into one multi-draw-indirect call
+		// Needs an OpenGL 4.3 context with shader draw parameters, see WindowPreferences, and is on by default where supported
+		void setMultiDraw(bool enabled);
+
+		// Return the stats of the latest frame whose GPU timings are known, a few frames old
+		const FrameStats& getFrameStats() const;
 
 
 		// Set the filter color
 		void setColorFilter(glt::vec4f color);
+
+		// Return the filter color
+		glt::vec4f getColorFilter() const;
+
+
+		// Draw to a render target instead of the window, or to the window again if null
+		// The viewport covers the whole target
+		void setRenderTarget(RenderTarget* target);
+
+		// Return the target being drawn to, null for the window
+		RenderTarget* getRenderTarget() const;
+
+
+		// Return the backend doing the drawing
+		RenderBackend& getBackend() const;
 	};
 }
 
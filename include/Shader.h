@@ -1,6 +1,16 @@
 #pragma once
 
+#include <vector>
+
 namespace xr {
+
+	// Binds an attribute name to a location
+	struct AttributeBinding {
+		GLuint location;
+		const char* name;
+	};
+
+
 	class Shader
 	{
 		// Handle to the OpenGL shader
@@ -8,7 +18,8 @@ namespace xr {
 
 	public:
 
-		Shader(const char* vertexSource, const char* fragmentSource);
+		// Compile and link a program, binding the attributes before it is linked
+		Shader(const char* vertexSource, const char* fragmentSource, const std::vector<AttributeBinding>& attributes = {});
 		~Shader();
 
 
@@ -16,9 +27,13 @@ namespace xr {
 		void use();
 
 
-		// Bind a attribute name to a location
+		// Bind a attribute name to a location, takes effect once the program is linked again
+		// Prefer passing the bindings to the constructor, linking is slow
 		void bindAttribute(GLuint location, const char* name);
 
+		// Link the program again, applying the attribute bindings made since it was linked
+		void link();
+
 
 		// Get the uniform's location from it's name
 		GLuint getUniformLocation(const char* name);
@@ -29,7 +44,10 @@ namespace xr {
 		GLuint compileShaderSource(const char* source, GLenum type);
 
 		// Create a new shader program from shaders
-		GLuint linkShaderProgram(GLuint vertexShader, GLuint fragmentShader);
+		GLuint linkShaderProgram(GLuint vertexShader, GLuint fragmentShader, const std::vector<AttributeBinding>& attributes);
+
+		// Link a program, throwing its log if that fails
+		static void linkProgram(GLuint program);
 
 	};
 }
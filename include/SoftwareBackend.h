@@ -0,0 +1,221 @@
+#pragma once
+
+#include <map>
+
+#include "Image.h"
+#include "RenderBackend.h"
+
+namespace xr {
+
+	// Rasterizes batches on the CPU into an image, needing no GPU or context
+	// Follows the GL backend's shaders and blend functions, so its output can serve as a reference for the GPU's
+	// The image is split into tiles that are rasterized on the job system's threads, each tile in draw order
+	class SoftwareBackend : public RenderBackend
+	{
+		// A vertex transformed to pixel coordinates
+		// For shapes the texture coordinates hold the position relative to the shape's center
+		struct RasterVertex {
+			float x, y;
+			float u, v;
+			float r, g, b, a;
+		};
+
+		// Three vertices sharing a material
+		struct RasterTriangle {
+			uint32_t vertices[3];
+			uint32_t material;
+		};
+
+		// How the pixels of a triangle are colored
+		struct Material {
+			// The image to sample, null for white
+			const Image* texture;
+
+			// How the color is blended with the image
+			BlendMode blend;
+
+			// Index of the shape to evaluate, -1 if not a shape
+			int shape;
+		};
+
+		// The signed distance field of a shape
+		struct Shape {
+			float halfWidth, halfHeight;
+			float radius;
+			float thickness;
+		};
+
+		// An edge of a triangle, E(x, y) is positive on the inside and zero along the edge
+		// Shared edges are evaluated from the same endpoint by both triangles, one getting exactly the negation
+		// of the other's value, so that every pixel center along the edge is drawn exactly once
+		struct Edge {
+			// The endpoint the edge is evaluated from, the lesser one
+			float x, y;
+
+			// Direction from the lesser to the greater endpoint
+			float dx, dy;
+
+			// 1 if the triangle runs along the edge from the lesser endpoint, -1 otherwise
+			float sign;
+
+			// Are pixel centers on the edge inside, by the top-left rule
+			bool inclusive;
+
+
+			Edge() {}
+			Edge(float ax, float ay, float bx, float by);
+
+			float evaluate(float px, float py) const {
+				return this->sign * (this->dx * (py - this->y) - this->dy * (px - this->x));
+			}
+
+			bool inside(float px, float py) const {
+				float e = this->evaluate(px, py);
+				return this->inclusive ? e >= 0 : e > 0;
+			}
+		};
+
+		// An attribute varying linearly over a triangle
+		struct Plane {
+			float base, dx, dy;
+
+			float at(float px, float py) const {
+				return this->base + this->dx * px + this->dy * py;
+			}
+		};
+
+		// A triangle ready to be rasterized, copied into every tile it touches
+		struct SetupTriangle {
+			Edge edges[3];
+
+			// The color planes, one channel per element
+			float colorBase[4], colorDx[4], colorDy[4];
+
+			// Texture coordinates, or the position within a shape
+			Plane u, v;
+
+			// Bounds of the covered pixels
+			int minX, minY, maxX, maxY;
+
+			uint32_t material;
+		};
+
+
+		// Size of the image
+		int width, height;
+
+		// Colors of the image, four floats per pixel with the top row first
+		std::vector<float> pixels;
+
+		// Number of parts the triangles of a submit are set up in, each binning into tiles of its own
+		int threadCount;
+
+
+		// Images of textures, by handle
+		std::map<GLuint, Image> textures;
+
+		// Images of the layers of texture arrays, by handle and layer
+		std::map<std::pair<GLuint, int>, Image> arrayLayers;
+
+		// Handle of the next texture made by the backend, counting down so as not to meet GL handles
+		GLuint nextTextureHandle;
+
+
+		// Geometry of the submit being rasterized, reused between submits
+		std::vector<RasterVertex> vertices;
+		std::vector<RasterTriangle> triangles;
+		std::vector<Material> materials;
+		std::vector<Shape> shapes;
+
+		// The triangles touching each tile, for each part of the triangles
+		// Every part is a consecutive range of triangles, so going through the parts in order keeps the draw order
+		std::vector<std::vector<std::vector<SetupTriangle>>> bins;
+
+		// Number of tiles
+		int tileCount;
+
+		// Number of tiles in each row
+		int tilesX;
+
+		// Filter color of the submit being rasterized
+		glt::vec4f colorFilter;
+
+
+		// Is a render target bound, whose draws are dropped
+		bool drawingToTarget;
+
+		// Counts the draws of each frame
+		RenderProfiler profiler;
+
+	public:
+
+		// Rasterize into an image of a size, setting up triangles in a number of parts, 0 for one per thread
+		// The work runs on the engine's job system
+		SoftwareBackend(int width, int height, int threads = 0);
+
+
+		// Change the size of the image, clearing it
+		void resize(int width, int height);
+
+		// Return the size of the image
+		int getWidth() const;
+		int getHeight() const;
+
+		// Return a copy of the image drawn so far, the first row is the top of the view
+		Image getImage() const;
+
+
+		// Create a texture that only this backend can sample, no context needed
+		Texture createTexture(const Image& image);
+
+		// Sample an image wherever a texture made by OpenGL is drawn, unknown textures sample as white
+		void setTextureImage(const Texture& texture, const Image& image);
+
+		// Sample an image wherever a layer of a texture array is drawn
+		void setTextureImage(const TextureArray& textureArray, int layer, const Image& image);
+
+
+		void clear(glt::vec4f color) override;
+
+		void submit(const DrawList& list, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label) override;
+
+		// The geometry of static batches only exists on the GPU, they are counted but not drawn
+		void submit(StaticBatch& batch, const glt::mat4f& transformation, glt::vec4f colorFilter, const char* label) override;
+
+		// Render targets live on the GPU, draws to them are dropped until the window is drawn to again
+		void setRenderTarget(RenderTarget* target) override;
+
+		void endFrame() override;
+
+
+		// The stats of a frame are known as soon as it ends
+		const FrameStats& getFrameStats() const override;
+
+	private:
+
+		// Return the image sampled for a texture, null if unknown
+		const Image* findImage(const Texture& texture) const;
+		const Image* findImage(const TextureArray& textureArray, int layer) const;
+
+
+		// Turn a list of draws into triangles, the first source is at 'sources'
+		void setup(const std::vector<DrawList::Draw>& draws, const DrawList::Source* sources, const glt::mat4f& transformation);
+
+		// Add a quad of four vertices in order around its edge to the triangles
+		void addQuad(const RasterVertex corners[4], uint32_t material);
+
+
+		// Set up the triangles, sort them into the tiles they touch and rasterize all tiles
+		void rasterize();
+
+		// Set up a triangle for rasterizing, return false if it covers no pixels
+		bool setupTriangle(const RasterTriangle& triangle, SetupTriangle& setup) const;
+
+		// Rasterize the triangles touching a tile
+		void rasterizeTile(int tile);
+
+		// Rasterize the part of a triangle within a rectangle of pixels
+		void rasterizeTriangle(const SetupTriangle& triangle, int minX, int minY, int maxX, int maxY);
+	};
+
+}
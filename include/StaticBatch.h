@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Buffer.h"
+#include "RenderBatch.h"
+
+namespace xr {
+
+	// Geometry that is uploaded to the GPU once and drawn any number of times
+	// Recorded with a RenderBatch, whose transformation is ignored
+	class StaticBatch {
+		friend class GLBackend;
+
+		// Vertices and indices of all meshes
+		VertexBuffer vertexBuffer;
+
+		// All sprites
+		InstanceBuffer spriteBuffer;
+
+		// All shapes
+		InstanceBuffer shapeBuffer;
+
+		// Draws referring to the uploaded geometry
+		std::vector<DrawList::Draw> draws;
+
+	public:
+
+		StaticBatch();
+
+
+		// Upload the contents of a batch, replacing the previous geometry
+		void upload(const RenderBatch& batch);
+
+		// Remove all geometry
+		void clear();
+
+
+		// Return true if there is nothing to draw
+		bool empty() const;
+
+		// Return the draws referring to the uploaded geometry
+		const std::vector<DrawList::Draw>& getDraws() const;
+	};
+
+}
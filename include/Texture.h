@@ -20,6 +20,9 @@ namespace xr {
 		// Placeholder texture
 		Texture();
 
+		// Refer to a texture by its handle without creating one
+		static Texture fromHandle(GLuint handle);
+
 
 		// Bind this texture
 		void bind() const;
@@ -32,6 +35,10 @@ namespace xr {
 		void setMinMagFilter(GLenum min, GLenum mag);
 
 
+		// Return the handle to the texture
+		GLuint getHandle() const;
+
+
 		// Compare two textures (used for hashing in map)
 		bool operator<(const Texture& other) const;
 
@@ -68,4 +75,59 @@ namespace xr {
 
 	};
 
+
+	// Array of equally sized 2D-textures, addressed by layer
+	class TextureArray
+	{
+		// Handle to the texture
+		GLuint texture;
+
+		// Size of each layer
+		int width, height;
+
+		// Number of layers
+		int layers;
+
+	public:
+
+		// Create a new texture array with empty layers
+		TextureArray(int width, int height, int layers);
+
+		// Create a new texture array with one layer per image, all images must be the same size
+		TextureArray(const std::vector<Image>& images);
+
+		// Placeholder texture array
+		TextureArray();
+
+
+		// Replace the contents of a layer
+		void setLayer(int layer, const Image& image);
+
+
+		// Bind this texture array
+		void bind() const;
+
+		// Change the min and mag filters
+		void setMinMagFilter(GLenum min, GLenum mag);
+
+
+		// Return the size of each layer
+		int getWidth() const;
+		int getHeight() const;
+
+		// Return the number of layers
+		int getLayerCount() const;
+
+		// Return the handle to the texture
+		GLuint getHandle() const;
+
+
+		// Compare two texture arrays (used for hashing in map)
+		bool operator<(const TextureArray& other) const;
+
+		// Are two texture arrays pointing to same OpenGL texture?
+		bool operator==(const TextureArray& other) const;
+		bool operator!=(const TextureArray& other) const;
+	};
+
 }
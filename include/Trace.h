@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+
+// Record the time spent in the rest of the enclosing scope as a zone with a name
+// Compiled out unless XERUS_ENABLE_TRACING is defined, see the CMake option of the same name
+#ifdef XERUS_ENABLE_TRACING
+#define XR_TRACE_CONCAT_IMPL(a, b) a##b
+#define XR_TRACE_CONCAT(a, b) XR_TRACE_CONCAT_IMPL(a, b)
+#define XR_TRACE_SCOPE(name) xr::TraceScope XR_TRACE_CONCAT(xrTraceScope, __LINE__)(name)
+#else
+#define XR_TRACE_SCOPE(name) ((void)0)
+#endif
+
+
+namespace xr {
+
+	// Records zones of CPU time from any thread, for viewing in chrome://tracing
+	// Every thread writes to its own buffer, so recording never takes a lock
+	class Tracer {
+	public:
+
+		// Start recording zones
+		static void start();
+
+		// Stop recording zones
+		static void stop();
+
+		// Return true if zones are being recorded
+		static bool isRecording();
+
+
+		// Write all recorded zones to a file in the Chrome trace event format
+		static void exportChromeTrace(const std::string& path);
+
+		// Discard all recorded zones, only call while no zones are being recorded
+		static void clear();
+
+		// Return the number of zones that didn't fit in their thread's buffer
+		static size_t getDroppedCount();
+
+
+		// Record a finished zone, times are in nanoseconds since the tracer was first used
+		// The name has to outlive the tracer, like a string literal
+		static void record(const char* name, uint64_t start, uint64_t end);
+
+		// Return the time in nanoseconds since the tracer was first used
+		static uint64_t now();
+	};
+
+
+	// Records a zone from construction until destruction, use XR_TRACE_SCOPE instead of this directly
+	class TraceScope {
+
+		// Name of the zone
+		const char* name;
+
+		// Was the tracer recording when the zone started
+		bool recording;
+
+		// When the zone started
+		uint64_t start;
+
+	public:
+
+		TraceScope(const char* name)
+			: name(name), recording(Tracer::isRecording()), start(recording ? Tracer::now() : 0) {}
+
+		~TraceScope() {
+			if (this->recording) {
+				Tracer::record(this->name, this->start, Tracer::now());
+			}
+		}
+
+		TraceScope(const TraceScope&) = delete;
+		TraceScope& operator=(const TraceScope&) = delete;
+	};
+
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <glt.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace xr {
+
+	// Split a simple polygon with holes into triangles by ear clipping
+	// The outline and holes may be in any winding order, but must not intersect themselves or each other
+	// Writes three indices per triangle, the points of the holes follow those of the outline
+	void triangulate(const std::vector<glt::vec2f>& outline,
+					 const std::vector<std::vector<glt::vec2f>>& holes,
+					 std::vector<uint32_t>& indices);
+
+
+	// Remembers the triangulations of recently drawn polygons
+	class TriangulationCache {
+
+		struct Entry {
+			// The triangulated points, outline first
+			std::vector<glt::vec2f> points;
+
+			// Number of points in each hole
+			std::vector<size_t> holeSizes;
+
+			// The triangles
+			std::vector<uint32_t> indices;
+
+			// When the entry was last used
+			uint64_t lastUse;
+		};
+
+
+		// Entries by the hash of their points
+		std::unordered_map<uint64_t, Entry> entries;
+
+		// Increases with every lookup
+		uint64_t useCounter;
+
+		// Most entries to keep
+		size_t capacity;
+
+	public:
+
+		// Create a cache holding at most 'capacity' polygons
+		TriangulationCache(size_t capacity = 256);
+
+
+		// Return the triangles of a polygon, only triangulating it if it isn't cached
+		// The least recently used polygon is forgotten when the cache is full
+		const std::vector<uint32_t>& get(const std::vector<glt::vec2f>& outline,
+										 const std::vector<std::vector<glt::vec2f>>& holes);
+
+		// Forget all polygons
+		void clear();
+
+	private:
+
+		// Return true if an entry holds the given polygon
+		static bool matches(const Entry& entry,
+							const std::vector<glt::vec2f>& outline,
+							const std::vector<std::vector<glt::vec2f>>& holes);
+	};
+
+}
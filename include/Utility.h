@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 
 namespace xr {
 	namespace util {
@@ -7,5 +8,12 @@ namespace xr {
 		// Loads a binary file from drive
 		std::vector<unsigned char> loadBytes(const char* path);
 
+
+		// Stable sort of values by their 64-bit keys, least significant byte first
+		// Passes where all keys share the same byte are skipped
+		// The scratch vectors are overwritten, keep them between calls so that nothing is allocated
+		void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+					   std::vector<uint64_t>& scratchKeys, std::vector<uint32_t>& scratchValues);
+
 	}
 }
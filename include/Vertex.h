@@ -3,25 +3,124 @@
 #include <glt.hpp>
 
 namespace xr {
+
+	// Color with 8 bits per channel
+	struct PackedColor {
+		GLubyte r, g, b, a;
+
+
+		PackedColor()
+			: r(255), g(255), b(255), a(255) {}
+
+		explicit PackedColor(const glt::vec4f &color)
+			: r(pack(color.r)), g(pack(color.g)), b(pack(color.b)), a(pack(color.a)) {}
+
+	private:
+
+		// Convert a channel in the range [0, 1]
+		static GLubyte pack(float channel) {
+			channel = channel < 0.0f ? 0.0f : (channel > 1.0f ? 1.0f : channel);
+			return static_cast<GLubyte>(channel * 255.0f + 0.5f);
+		}
+	};
+
+
+	// Texture coordinates with 16 bits of fixed point per component, 8192 steps per texture
+	// Covers [-4, 4) to leave room for repeating textures, coordinates outside of it are clamped
+	// The shaders unpack them with the same scale and offset
+	struct PackedTexCoord {
+		GLushort u, v;
+
+		// Steps per texture, and the packed value of 0
+		static constexpr float SCALE = 8192.0f;
+		static constexpr float OFFSET = 32768.0f;
+
+
+		PackedTexCoord()
+			: u(pack(0.0f)), v(pack(0.0f)) {}
+
+		explicit PackedTexCoord(const glt::vec2f &texCoord)
+			: u(pack(texCoord.x)), v(pack(texCoord.y)) {}
+
+
+		// Convert a packed component back
+		static float unpack(GLushort component) {
+			return (component - OFFSET) / SCALE;
+		}
+
+	private:
+
+		// Convert a component, clamped to the range that fits
+		static GLushort pack(float component) {
+			float packed = component * SCALE + OFFSET + 0.5f;
+			packed = packed < 0.0f ? 0.0f : (packed > 65535.0f ? 65535.0f : packed);
+			return static_cast<GLushort>(packed);
+		}
+	};
+
+
+	// 2D vertex, 16 bytes large
 	struct Vertex {
-		glt::vec3f position;
-		glt::vec2f texCoord;
-		glt::vec4f color;
+		glt::vec2f position;
+		PackedTexCoord texCoord;
+		PackedColor color;
 
 
 		Vertex()
-			: position(0.0), texCoord(0.0), color(1.0) {}
-
-        explicit Vertex(const glt::vec3f &position)
-			: position(position), texCoord(0.0), color(1.0) {}
+			: position(0.0f) {}
 
-		Vertex(const glt::vec3f &position, const glt::vec4f &color)
-			: position(position), texCoord(0.0), color(color) {}
+		explicit Vertex(const glt::vec2f &position)
+			: position(position) {}
 
-		Vertex(const glt::vec3f &position, const glt::vec2f &texCoord)
-			: position(position), texCoord(texCoord), color(1.0) {}
+		Vertex(const glt::vec2f &position, PackedTexCoord texCoord, PackedColor color)
+			: position(position), texCoord(texCoord), color(color) {}
 
-		Vertex(const glt::vec3f &position, const glt::vec2f &texCoord, const glt::vec4f &color)
+		Vertex(const glt::vec2f &position, const glt::vec2f &texCoord, const glt::vec4f &color)
 			: position(position), texCoord(texCoord), color(color) {}
 	};
-}
\ No newline at end of file
+
+
+	// Per-instance data of a sprite, 36 bytes large
+	struct SpriteInstance {
+		// Corner of the sprite before rotation
+		glt::vec2f position;
+
+		// Width and height
+		glt::vec2f size;
+
+		// Texture coordinates at the sprite's minimum and maximum corner
+		PackedTexCoord texCoordMin, texCoordMax;
+
+		// Color to tint the sprite with
+		PackedColor color;
+
+		// Rotation around the sprite's center, in radians
+		float rotation;
+
+		// Layer to sample when drawn with a texture array
+		GLuint layer;
+	};
+
+
+	// Per-instance data of a rounded box, evaluated as a signed distance field, 32 bytes large
+	// Circles, rings and capsules are rounded boxes with fully rounded corners
+	struct ShapeInstance {
+		// Center of the shape
+		glt::vec2f center;
+
+		// Half of the width and height, before rotation
+		glt::vec2f halfSize;
+
+		// Rotation around the center, in radians
+		float rotation;
+
+		// Radius of the corners
+		float radius;
+
+		// Width of the outline, 0 if filled
+		float thickness;
+
+		// Color of the shape
+		PackedColor color;
+	};
+}
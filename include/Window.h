@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <chrono>
 #include <functional>
 
 #include "OpenGL.h"
@@ -54,14 +55,20 @@ namespace xr {
 	};
 
 
+	// With a render thread, only the render thread swaps the buffers, the rest is used on the game thread
+	// Events are polled there too, so update can keep using the window unless it is pipelined
 	class Window
 	{
 		// Handle to the GLFW window
 		GLFWwindow* glfwHandle;
 
-		// The time between the two most recent calls to swapBuffers
+		// The time between the two most recent frames
 		double lastFrameTime;
 
+		// When the most recent frame was measured, if any
+		std::chrono::high_resolution_clock::time_point lastFrame;
+		bool frameMeasured;
+
 		// This size of this window
 		glt::vec2i size;
 
@@ -104,16 +111,21 @@ namespace xr {
 		// Poll the window for events
 		void pollEvents();
 
-		// Swap the window buffers
-		void swapBuffers();
+		// Swap the window buffers, measuring the frame time unless told otherwise
+		// A render thread swaps without measuring, the game thread measures as it hands frames over instead
+		void swapBuffers(bool measureFrameTime = true);
 
-		// Calculate the time between the two most recent calls to swapBuffers
+		// Calculate the time since the previous frame, only call from the game thread
 		void calculateLastFrameTime();
 
-		// Return the time between the two most recent calls to swapBuffers
+		// Return the time between the two most recent frames
 		double getLastFrameTime();
 
 
+		// Return the GLFW window, which owns the context
+		GLFWwindow* getHandle();
+
+
 		// Return the size of the window
 		int getWidth();
 		int getHeight();
@@ -165,6 +177,10 @@ namespace xr {
 		// Load the opengl bindings
 		void loadGL();
 
+		// Return true if the window's context is current on the calling thread
+		// Otherwise a render thread owns it, which applies the viewport and vsync itself
+		bool isContextCurrent();
+
 		// Set the settings for the window and OpenGL
 		void setup(WindowPreferences preferences);
 
@@ -2,11 +2,20 @@
 #include "stdafx.h"
 
 #include "Utility.h"
+#include "Trace.h"
+#include "JobSystem.h"
+#include "Async.h"
 #include "Interpolation.h"
+#include "DoubleBuffered.h"
 
 #include "Window.h"
 
 #include "Renderer.h"
+#include "RenderThread.h"
+#include "NullBackend.h"
+#include "SoftwareBackend.h"
+#include "CachedLayer.h"
+#include "GLState.h"
 
 #include "Texture.h"
 #include "Image.h"
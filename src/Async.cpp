@@ -0,0 +1,63 @@
+#include "stdafx.h"
+#include "Async.h"
+
+#include <iterator>
+
+
+void xr::AsyncScheduler::Remote::schedule(std::function<void()> work) const
+{
+	std::shared_ptr<Queue> queue = this->queue.lock();
+	if (queue) {
+		std::lock_guard<std::mutex> lock(queue->mutex);
+		queue->ready.push_back(std::move(work));
+	}
+}
+
+
+
+xr::AsyncScheduler::AsyncScheduler() :
+	queue(std::make_shared<Queue>())
+{
+}
+
+void xr::AsyncScheduler::schedule(std::function<void()> work)
+{
+	std::lock_guard<std::mutex> lock(this->queue->mutex);
+	this->queue->ready.push_back(std::move(work));
+}
+
+xr::AsyncScheduler::Remote xr::AsyncScheduler::getRemote() const
+{
+	Remote remote;
+	remote.queue = this->queue;
+	return remote;
+}
+
+void xr::AsyncScheduler::update()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->queue->mutex);
+		if (this->queue->ready.empty()) {
+			return;
+		}
+		this->resuming.swap(this->queue->ready);
+	}
+
+	size_t i = 0;
+	try {
+		for (; i < this->resuming.size(); i++) {
+			this->resuming[i]();
+		}
+	}
+	catch (...) {
+		// Keep the work that didn't run yet for the next update
+		std::lock_guard<std::mutex> lock(this->queue->mutex);
+		this->queue->ready.insert(this->queue->ready.begin(),
+			std::make_move_iterator(this->resuming.begin() + i + 1),
+			std::make_move_iterator(this->resuming.end()));
+		this->resuming.clear();
+		throw;
+	}
+
+	this->resuming.clear();
+}
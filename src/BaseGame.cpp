@@ -1,12 +1,26 @@
 #include "stdafx.h"
 #include "BaseGame.h"
 
+#include <cmath>
+
 
 
 
 namespace xr {	
 	BaseGame::BaseGame() :
-		clearColor(0, 0, 0, 1)
+		clearColor(0, 0, 0, 1),
+		window(nullptr),
+		headless(false),
+		stopped(false),
+		renderThreadEnabled(false),
+		pipelined(false),
+		fixedTimestep(0),
+		maxFixedSteps(0),
+		accumulator(0),
+		advanced(false),
+		updatedInterpolation(0),
+		renderedInterpolation(0),
+		tickTime(0)
 	{
 	}
 
@@ -15,9 +29,166 @@ namespace xr {
 		return *this->window;
 	}
 
+	bool BaseGame::isHeadless() const
+	{
+		return this->headless;
+	}
+
+	void BaseGame::stop()
+	{
+		this->stopped = true;
+	}
+
+	JobSystem & BaseGame::getJobs()
+	{
+		return JobSystem::get();
+	}
+
+	AsyncScheduler & BaseGame::getScheduler()
+	{
+		return this->scheduler;
+	}
+
 	void BaseGame::setClearColor(float r, float g, float b, float a)
 	{
 		this->clearColor = { r, g, b, a };
 	}
+
+	void BaseGame::setRenderThreadEnabled(bool enabled)
+	{
+		this->renderThreadEnabled = enabled;
+	}
+
+	void BaseGame::setPipelined(bool enabled)
+	{
+		this->pipelined = enabled;
+	}
+
+	void BaseGame::setFixedTimestep(double timestep, int maxSteps)
+	{
+		this->fixedTimestep = timestep > 0 ? timestep : 0;
+		this->maxFixedSteps = maxSteps > 0 ? maxSteps : 1;
+		this->accumulator = 0;
+		this->updatedInterpolation = 0;
+	}
+
+	double BaseGame::getFixedTimestep() const
+	{
+		return this->fixedTimestep;
+	}
+
+	bool BaseGame::isRunning() const
+	{
+		return !this->stopped && (this->headless || this->window->isOpen());
+	}
+
+	void BaseGame::advance()
+	{
+		using namespace std::chrono;
+
+		// The first frame starts the clock, whatever happened in setup isn't simulated
+		steady_clock::time_point now = steady_clock::now();
+		double elapsed = this->advanced ? duration<double>(now - this->lastAdvance).count() : 0;
+		this->lastAdvance = now;
+		this->advanced = true;
+
+		// Simulated frames all take the same time
+		if (this->tickTime > 0) {
+			elapsed = this->tickTime;
+		}
+
+		if (this->fixedTimestep > 0) {
+			XR_TRACE_SCOPE("BaseGame::fixedUpdate");
+
+			this->accumulator += elapsed;
+
+			int steps = 0;
+			while (this->accumulator >= this->fixedTimestep) {
+				// Drop what can't be caught up, or every frame would take longer than the last
+				if (steps == this->maxFixedSteps) {
+					this->accumulator = std::fmod(this->accumulator, this->fixedTimestep);
+					break;
+				}
+
+				this->fixedUpdate(this->fixedTimestep);
+				this->accumulator -= this->fixedTimestep;
+				steps++;
+			}
+
+			this->updatedInterpolation = this->accumulator / this->fixedTimestep;
+		}
+
+		this->update();
+	}
+
+
+
+	UpdateThread::UpdateThread(std::function<void()> update) :
+		update(std::move(update)),
+		pending(false),
+		stopping(false),
+		thread(&UpdateThread::run, this)
+	{
+	}
+
+	UpdateThread::~UpdateThread()
+	{
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->finished.wait(lock, [this]() { return !this->pending; });
+			this->stopping = true;
+		}
+		this->started.notify_one();
+
+		this->thread.join();
+	}
+
+	void UpdateThread::start()
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->pending = true;
+		}
+		this->started.notify_one();
+	}
+
+	void UpdateThread::wait()
+	{
+		std::unique_lock<std::mutex> lock(this->mutex);
+		this->finished.wait(lock, [this]() { return !this->pending; });
+
+		if (this->error) {
+			std::exception_ptr error = this->error;
+			this->error = nullptr;
+			std::rethrow_exception(error);
+		}
+	}
+
+	void UpdateThread::run()
+	{
+		std::unique_lock<std::mutex> lock(this->mutex);
+
+		while (true) {
+			this->started.wait(lock, [this]() { return this->pending || this->stopping; });
+			if (this->stopping) {
+				return;
+			}
+
+			lock.unlock();
+
+			std::exception_ptr error;
+			try {
+				this->update();
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+
+			lock.lock();
+			this->error = error;
+			this->pending = false;
+			this->finished.notify_one();
+		}
+	}
 }
 
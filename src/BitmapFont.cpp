@@ -20,7 +20,7 @@ void xr::BitmapFont::renderText(std::string text, glt::vec2f position, xr::Rende
             const Character& character = it->second;
             batch->setTexture(character.region);
 
-            batch->fillRect(position + character.offset, character.size);
+            batch->drawSprite(position + character.offset, character.size);
 
             position.x += character.advance;
         } else {
@@ -1,8 +1,31 @@
 #include "stdafx.h"
 #include "Buffer.h"
+#include "GLState.h"
 
+#include <cstring>
 
-xr::Buffer::Buffer(GLenum bufferType)
+
+// Initial size of a streaming region for vertices, in bytes
+const GLsizeiptr STREAM_VERTEX_REGION_SIZE = 1 << 20;
+
+// Initial size of a streaming region for indices, in bytes
+const GLsizeiptr STREAM_INDEX_REGION_SIZE = 1 << 18;
+
+// Initial size of a streaming region for instances, in bytes
+const GLsizeiptr STREAM_INSTANCE_REGION_SIZE = 1 << 19;
+
+// How long to wait for a fence before polling again, in nanoseconds
+const GLuint64 STREAM_FENCE_TIMEOUT = 1000000;
+
+
+xr::Buffer::Buffer(GLenum bufferType) :
+	mappedData(nullptr),
+	regionSize(0),
+	regionCount(0),
+	currentRegion(0),
+	regionOffset(0),
+	frameBytes(0),
+	generation(1)
 {
 	this->type = bufferType;
 	glGenBuffers(1, &this->buffer);
@@ -10,75 +33,491 @@ xr::Buffer::Buffer(GLenum bufferType)
 
 xr::Buffer::~Buffer()
 {
+	this->releaseStream();
+	GLState::get().forgetBuffer(this->buffer);
 	glDeleteBuffers(1, &this->buffer);
 }
 
-void xr::Buffer::upload(void * data, int length)
+void xr::Buffer::upload(void * data, int length, GLenum usage)
 {
+	// Streaming storage may be immutable
+	if (this->isStreaming()) {
+		this->releaseStream();
+	}
+
 	this->bind();
-	glBufferData(this->type, length, data, GL_DYNAMIC_DRAW);
+	glBufferData(this->type, length, data, usage);
 }
 
 void xr::Buffer::bind()
 {
-	glBindBuffer(this->type, this->buffer);
+	GLState::get().bindBuffer(this->type, this->buffer);
+}
+
+GLuint xr::Buffer::getHandle() const
+{
+	return this->buffer;
+}
+
+bool xr::Buffer::isStreaming() const
+{
+	return this->regionCount > 0;
+}
+
+unsigned xr::Buffer::getGeneration() const
+{
+	return this->generation;
+}
+
+void xr::Buffer::allocateStream(GLsizeiptr size, int regions)
+{
+	this->releaseStream();
+
+	this->regionSize = size;
+	this->regionCount = regions;
+	this->currentRegion = 0;
+	this->regionOffset = 0;
+	this->regionFences.assign(regions, nullptr);
+
+	GLsizeiptr capacity = size * regions;
+
+	if (GLEW_ARB_buffer_storage) {
+		// Immutable storage can only be allocated once per buffer object
+		GLState::get().forgetBuffer(this->buffer);
+		glDeleteBuffers(1, &this->buffer);
+		glGenBuffers(1, &this->buffer);
+		this->generation++;
+		this->bind();
+
+		// Keep the storage mapped for as long as it exists
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(this->type, capacity, nullptr, flags);
+		this->mappedData = static_cast<unsigned char*>(glMapBufferRange(this->type, 0, capacity, flags));
+	}
+	else {
+		this->bind();
+		glBufferData(this->type, capacity, nullptr, GL_STREAM_DRAW);
+	}
+}
+
+void xr::Buffer::reserve(GLsizeiptr length)
+{
+	// Grow the ring if the data can never fit in a region
+	if (length > this->regionSize) {
+		GLsizeiptr size = this->regionSize > 0 ? this->regionSize : 1;
+		while (size < length) {
+			size *= 2;
+		}
+
+		this->allocateStream(size, this->isStreaming() ? this->regionCount : STREAM_REGION_COUNT);
+		return;
+	}
+
+	// Continue in the next region if this one is full
+	if (this->regionOffset + length > this->regionSize) {
+		this->fence();
+	}
+}
+
+GLintptr xr::Buffer::stream(const void * data, GLsizeiptr length, GLsizeiptr alignment)
+{
+	// Does nothing if the space was reserved together with other data
+	this->reserve(length + alignment);
+
+	GLintptr regionStart = this->currentRegion * this->regionSize;
+	GLintptr offset = (regionStart + this->regionOffset + alignment - 1) / alignment * alignment;
+
+	this->frameBytes += length + alignment;
+
+	if (length == 0) {
+		return offset;
+	}
+
+	if (this->mappedData) {
+		memcpy(this->mappedData + offset, data, length);
+	}
+	else {
+		// The fences guarantee that the GPU isn't reading from this range
+		this->bind();
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+		void* target = glMapBufferRange(this->type, offset, length, flags);
+		memcpy(target, data, length);
+		glUnmapBuffer(this->type);
+	}
+
+	this->regionOffset = offset + length - regionStart;
+
+	return offset;
+}
+
+void xr::Buffer::fence()
+{
+	// Nothing to protect
+	if (!this->isStreaming() || this->regionOffset == 0) {
+		return;
+	}
+
+	// Signal when the GPU is done with the commands reading this region
+	this->regionFences[this->currentRegion] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	this->currentRegion = (this->currentRegion + 1) % this->regionCount;
+	this->regionOffset = 0;
+
+	// Wait until the GPU has finished reading the next region
+	GLsync& next = this->regionFences[this->currentRegion];
+	if (next) {
+		while (glClientWaitSync(next, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_FENCE_TIMEOUT) == GL_TIMEOUT_EXPIRED);
+
+		glDeleteSync(next);
+		next = nullptr;
+	}
+}
+
+void xr::Buffer::endFrame()
+{
+	this->fence();
+
+	// A frame that wrapped around waits for its own fences, so make the next one fit in a region
+	if (this->isStreaming() && this->frameBytes > this->regionSize) {
+		GLsizeiptr size = this->regionSize;
+		while (size < this->frameBytes) {
+			size *= 2;
+		}
+
+		this->allocateStream(size, this->regionCount);
+	}
+
+	this->frameBytes = 0;
+}
+
+void xr::Buffer::releaseStream()
+{
+	for (GLsync fence : this->regionFences) {
+		if (fence) {
+			glDeleteSync(fence);
+		}
+	}
+	this->regionFences.clear();
+
+	// Immutable storage has to be replaced by a new buffer object
+	if (this->mappedData) {
+		GLState::get().forgetBuffer(this->buffer);
+		glDeleteBuffers(1, &this->buffer);
+		glGenBuffers(1, &this->buffer);
+		this->generation++;
+		this->mappedData = nullptr;
+	}
+
+	this->regionSize = 0;
+	this->regionCount = 0;
+	this->currentRegion = 0;
+	this->regionOffset = 0;
+	this->frameBytes = 0;
 }
 
 
 
 xr::VertexBuffer::VertexBuffer()
 	: vbo(GL_ARRAY_BUFFER),
-	  ibo(GL_ELEMENT_ARRAY_BUFFER)
+	  ibo(GL_ELEMENT_ARRAY_BUFFER),
+	  quadIbo(acquireQuadIndices()),
+	  drawSlots(acquireDrawSlots()),
+	  attachedVbo(0),
+	  attachedIbo(0)
 {
 	glGenVertexArrays(1, &this->vao);
-	glBindVertexArray(this->vao);
+	glGenVertexArrays(1, &this->quadVao);
 
-	this->vbo.bind();
+	this->attachBuffers();
+}
+
+xr::VertexBuffer::~VertexBuffer()
+{
+	GLState::get().forgetVertexArray(this->vao);
+	GLState::get().forgetVertexArray(this->quadVao);
+	glDeleteVertexArrays(1, &this->vao);
+	glDeleteVertexArrays(1, &this->quadVao);
+}
+
+void xr::VertexBuffer::upload(const std::vector<Vertex>& vertices, GLenum usage)
+{
+	GLState::get().bindVertexArray(this->vao);
+	this->vbo.upload((void*)vertices.data(), vertices.size() * sizeof(Vertex), usage);
+	this->attachBuffers();
+}
+
+void xr::VertexBuffer::upload(const std::vector<GLushort>& indices, GLenum usage) {
+	GLState::get().bindVertexArray(this->vao);
+	this->ibo.upload((void*)indices.data(), indices.size() * sizeof(GLushort), usage);
+	this->attachBuffers();
+}
+
+
+void xr::VertexBuffer::drawElements(GLuint count, GLuint offset, GLenum mode)
+{
+	GLState::get().bindVertexArray(this->vao);
+
+	glDrawElements(mode, count, GL_UNSIGNED_SHORT, (void*)(offset * sizeof(GLushort)));
+}
+
+void xr::VertexBuffer::reserve(size_t vertices, size_t indices, size_t writes)
+{
+	GLState::get().bindVertexArray(this->vao);
+
+	// Start streaming on first use
+	if (!this->vbo.isStreaming()) {
+		this->vbo.allocateStream(STREAM_VERTEX_REGION_SIZE);
+	}
+	if (!this->ibo.isStreaming()) {
+		this->ibo.allocateStream(STREAM_INDEX_REGION_SIZE);
+	}
+
+	// Each write may be padded by up to one element to align it
+	this->vbo.reserve((vertices + writes) * sizeof(Vertex));
+	this->ibo.reserve((indices + writes) * sizeof(GLushort));
+}
+
+xr::StreamRange xr::VertexBuffer::stream(const std::vector<Vertex>& vertices, const std::vector<GLushort>& indices)
+{
+	this->reserve(vertices.size(), indices.size(), 1);
+
+	// Align the vertices so that they can be addressed with a base vertex
+	GLintptr vertexOffset = this->vbo.stream(vertices.data(), vertices.size() * sizeof(Vertex), sizeof(Vertex));
+	GLintptr indexOffset = this->ibo.stream(indices.data(), indices.size() * sizeof(GLushort), sizeof(GLushort));
+
+	// The ring may have been reallocated
+	this->attachBuffers();
+
+	return {
+		static_cast<GLint>(vertexOffset / sizeof(Vertex)),
+		static_cast<GLuint>(indexOffset / sizeof(GLushort))
+	};
+}
+
+void xr::VertexBuffer::drawElements(GLuint count, GLuint offset, GLint baseVertex, GLenum mode)
+{
+	GLState::get().bindVertexArray(this->vao);
+
+	glDrawElementsBaseVertex(mode, count, GL_UNSIGNED_SHORT, (void*)(offset * sizeof(GLushort)), baseVertex);
+}
+
+void xr::VertexBuffer::drawQuads(GLuint quadCount, GLint firstVertex)
+{
+	GLState::get().bindVertexArray(this->quadVao);
+
+	// The indices only reach so far, continue from a new base vertex
+	for (GLuint quad = 0; quad < quadCount; quad += MAX_QUADS_PER_DRAW) {
+		GLuint count = std::min(quadCount - quad, MAX_QUADS_PER_DRAW);
+		glDrawElementsBaseVertex(GL_TRIANGLES, count * 6, GL_UNSIGNED_SHORT, nullptr, firstVertex + quad * 4);
+	}
+}
+
+void xr::VertexBuffer::multiDrawIndirect(GLintptr offset, GLsizei drawCount, bool quads)
+{
+	GLState::get().bindVertexArray(quads ? this->quadVao : this->vao);
+
+	glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_SHORT, (void*)offset, drawCount, 0);
+}
+
+void xr::VertexBuffer::endFrame()
+{
+	this->vbo.endFrame();
+	this->ibo.endFrame();
+
+	// The ring may have grown
+	this->attachBuffers();
+}
+
+void xr::VertexBuffer::attachBuffers()
+{
+	// Already pointing to the right buffers
+	if (this->attachedVbo == this->vbo.getGeneration() && this->attachedIbo == this->ibo.getGeneration()) {
+		return;
+	}
+
+	this->attachedVbo = this->vbo.getGeneration();
+	this->attachedIbo = this->ibo.getGeneration();
+
+	GLState::get().bindVertexArray(this->vao);
 	this->ibo.bind();
+	this->attachAttributes();
+
+	GLState::get().bindVertexArray(this->quadVao);
+	this->quadIbo->bind();
+	this->attachAttributes();
+}
+
+void xr::VertexBuffer::attachAttributes()
+{
+	this->vbo.bind();
 
 	// Enable attributes
 	// Position
 	glEnableVertexAttribArray(ATTR_POSITION);
-	glVertexAttribPointer(ATTR_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, position)));
+	glVertexAttribPointer(ATTR_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, position)));
 
-	// Texture coordiantes
+	// Texture coordiantes, 16-bit fixed point unpacked by the shaders
 	glEnableVertexAttribArray(ATTR_TEX_COORD);
-	glVertexAttribPointer(ATTR_TEX_COORD, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, texCoord)));
+	glVertexAttribPointer(ATTR_TEX_COORD, 2, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, texCoord)));
 
-	// Color
+	// Color, normalized from 8 bits
 	glEnableVertexAttribArray(ATTR_COLOR);
-	glVertexAttribPointer(ATTR_COLOR, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(offsetof(Vertex, color)));
+	glVertexAttribPointer(ATTR_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)(offsetof(Vertex, color)));
 
+	// Draw slot, read at the base instance of each draw
+	this->drawSlots->bind();
+	glEnableVertexAttribArray(ATTR_DRAW_SLOT);
+	glVertexAttribIPointer(ATTR_DRAW_SLOT, 1, GL_UNSIGNED_INT, sizeof(GLuint), nullptr);
+	glVertexAttribDivisor(ATTR_DRAW_SLOT, 1);
+}
 
-	glBindVertexArray(0);
+std::shared_ptr<xr::Buffer> xr::VertexBuffer::acquireQuadIndices()
+{
+	// Released together with the last vertex buffer, while the context still exists
+	static std::weak_ptr<Buffer> shared;
+
+	std::shared_ptr<Buffer> buffer = shared.lock();
+	if (buffer) {
+		return buffer;
+	}
+
+	std::vector<GLushort> indices;
+	indices.reserve(MAX_QUADS_PER_DRAW * 6);
+	for (GLuint quad = 0; quad < MAX_QUADS_PER_DRAW; quad++) {
+		GLushort first = static_cast<GLushort>(quad * 4);
+		for (GLushort corner : { 0, 1, 2, 2, 3, 0 }) {
+			indices.push_back(first + corner);
+		}
+	}
+
+	// Don't disturb the element array binding of whatever VAO is bound
+	GLState::get().bindVertexArray(0);
+
+	buffer = std::make_shared<Buffer>(GL_ELEMENT_ARRAY_BUFFER);
+	buffer->upload(indices.data(), indices.size() * sizeof(GLushort), GL_STATIC_DRAW);
+
+	shared = buffer;
+	return buffer;
 }
 
-xr::VertexBuffer::~VertexBuffer()
+std::shared_ptr<xr::Buffer> xr::VertexBuffer::acquireDrawSlots()
+{
+	static std::weak_ptr<Buffer> shared;
+
+	std::shared_ptr<Buffer> buffer = shared.lock();
+	if (buffer) {
+		return buffer;
+	}
+
+	std::vector<GLuint> slots(MAX_DRAW_SLOTS);
+	for (GLuint slot = 0; slot < MAX_DRAW_SLOTS; slot++) {
+		slots[slot] = slot;
+	}
+
+	buffer = std::make_shared<Buffer>(GL_ARRAY_BUFFER);
+	buffer->upload(slots.data(), slots.size() * sizeof(GLuint), GL_STATIC_DRAW);
+
+	shared = buffer;
+	return buffer;
+}
+
+
+
+xr::InstanceBuffer::InstanceBuffer(GLsizei stride, const std::vector<InstanceAttribute>& attributes)
+	: buffer(GL_ARRAY_BUFFER),
+	  stride(stride),
+	  attributes(attributes),
+	  attachedBuffer(0),
+	  attachedOffset(0)
+{
+	glGenVertexArrays(1, &this->vao);
+	GLState::get().bindVertexArray(this->vao);
+
+	// Every attribute advances once per instance
+	for (auto& attribute : this->attributes) {
+		glEnableVertexAttribArray(attribute.location);
+		glVertexAttribDivisor(attribute.location, 1);
+	}
+}
+
+xr::InstanceBuffer::~InstanceBuffer()
 {
+	GLState::get().forgetVertexArray(this->vao);
 	glDeleteVertexArrays(1, &this->vao);
 }
 
-void xr::VertexBuffer::upload(const std::vector<Vertex>& vertices)
+void xr::InstanceBuffer::upload(const void * instances, GLsizei count, GLenum usage)
 {
-	glBindVertexArray(this->vao);
-	this->vbo.upload((void*)vertices.data(), vertices.size() * sizeof(Vertex));
-	glBindVertexArray(0);
+	this->buffer.upload((void*)instances, count * this->stride, usage);
 }
 
-void xr::VertexBuffer::upload(const std::vector<GLuint>& indices) {
-	glBindVertexArray(this->vao);
-	this->ibo.upload((void*)indices.data(), indices.size() * sizeof(GLuint));
-	glBindVertexArray(0);
+void xr::InstanceBuffer::reserve(size_t instances, size_t writes)
+{
+	// Start streaming on first use
+	if (!this->buffer.isStreaming()) {
+		this->buffer.allocateStream(STREAM_INSTANCE_REGION_SIZE);
+	}
+
+	// Each write may be padded by up to one instance to align it
+	this->buffer.reserve((instances + writes) * this->stride);
 }
 
+GLintptr xr::InstanceBuffer::stream(const void * instances, GLsizei count)
+{
+	this->reserve(count, 1);
 
-void xr::VertexBuffer::drawElements(GLuint count, GLuint offset, GLenum mode)
+	return this->buffer.stream(instances, count * this->stride, this->stride);
+}
+
+void xr::InstanceBuffer::drawInstanced(GLsizei count, GLintptr offset, GLenum mode, GLsizei vertices)
 {
-	glBindVertexArray(this->vao);
-	
-	glDrawElements(mode, count, GL_UNSIGNED_INT, (void*)(offset * sizeof(GLuint)));
+	GLState::get().bindVertexArray(this->vao);
+
+	// Without a base instance the attributes have to start at the instances
+	if (this->attachedBuffer != this->buffer.getGeneration() || this->attachedOffset != offset) {
+		this->attachedBuffer = this->buffer.getGeneration();
+		this->attachedOffset = offset;
 
-	glBindVertexArray(0);
+		this->buffer.bind();
+		for (auto& attribute : this->attributes) {
+			void* pointer = (void*)(offset + attribute.offset);
+			if (attribute.type == GL_FLOAT || attribute.normalized) {
+				glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, this->stride, pointer);
+			}
+			else {
+				glVertexAttribIPointer(attribute.location, attribute.size, attribute.type, this->stride, pointer);
+			}
+		}
+	}
+
+	glDrawArraysInstanced(mode, 0, vertices, count);
 }
 
+void xr::InstanceBuffer::endFrame()
+{
+	this->buffer.endFrame();
+}
 
+
+std::vector<xr::InstanceAttribute> xr::getSpriteInstanceAttributes()
+{
+	return {
+		{ ATTR_SPRITE_POSITION, 2, GL_FLOAT, GL_FALSE, offsetof(SpriteInstance, position) },
+		{ ATTR_SPRITE_SIZE, 2, GL_FLOAT, GL_FALSE, offsetof(SpriteInstance, size) },
+		{ ATTR_SPRITE_TEX_REGION, 4, GL_UNSIGNED_SHORT, GL_FALSE, offsetof(SpriteInstance, texCoordMin) },
+		{ ATTR_SPRITE_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(SpriteInstance, color) },
+		{ ATTR_SPRITE_ROTATION, 1, GL_FLOAT, GL_FALSE, offsetof(SpriteInstance, rotation) },
+		{ ATTR_SPRITE_LAYER, 1, GL_UNSIGNED_INT, GL_FALSE, offsetof(SpriteInstance, layer) },
+	};
+}
+
+std::vector<xr::InstanceAttribute> xr::getShapeInstanceAttributes()
+{
+	return {
+		{ ATTR_SHAPE_CENTER, 2, GL_FLOAT, GL_FALSE, offsetof(ShapeInstance, center) },
+		{ ATTR_SHAPE_HALF_SIZE, 2, GL_FLOAT, GL_FALSE, offsetof(ShapeInstance, halfSize) },
+		// Rotation, radius and thickness
+		{ ATTR_SHAPE_PARAMETERS, 3, GL_FLOAT, GL_FALSE, offsetof(ShapeInstance, rotation) },
+		{ ATTR_SHAPE_COLOR, 4, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(ShapeInstance, color) },
+	};
+}
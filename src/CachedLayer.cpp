@@ -0,0 +1,101 @@
+#include "stdafx.h"
+#include "CachedLayer.h"
+#include "Renderer.h"
+
+#include <cmath>
+
+
+// Relative change of the view's size that counts as zooming
+const float CACHED_LAYER_ZOOM_TOLERANCE = 0.001f;
+
+
+xr::CachedLayer::CachedLayer(int viewportWidth, int viewportHeight, float margin) :
+	target(int(viewportWidth * (1 + 2 * margin)), int(viewportHeight * (1 + 2 * margin))),
+	bounds(0, 0, 0, 0),
+	viewSize(0.0f),
+	margin(margin),
+	valid(false)
+{
+}
+
+void xr::CachedLayer::invalidate()
+{
+	this->valid = false;
+}
+
+void xr::CachedLayer::resize(int viewportWidth, int viewportHeight)
+{
+	this->target.resize(int(viewportWidth * (1 + 2 * this->margin)), int(viewportHeight * (1 + 2 * this->margin)));
+	this->valid = false;
+}
+
+bool xr::CachedLayer::update(Renderer & renderer, const Camera & camera, const std::function<void(RenderBatch&)>& draw)
+{
+	Rectangle<float> view = camera.getViewBounds();
+	if (this->valid && this->covers(view)) {
+		return false;
+	}
+
+	// Cover the view and the margin around it
+	float marginX = view.width * this->margin;
+	float marginY = view.height * this->margin;
+	this->bounds = Rectangle<float>(view.x - marginX, view.y - marginY, view.width + 2 * marginX, view.height + 2 * marginY);
+	this->viewSize = { view.width, view.height };
+
+	// The top of the bounds ends up at the top of the texture, as texture regions expect
+	glt::mat4f transformation = glt::orthographic(this->bounds.x, this->bounds.x + this->bounds.width,
+												  this->bounds.y + this->bounds.height, this->bounds.y);
+
+	this->batch.begin(transformation);
+	this->batch.setPixelSize(this->bounds.width / this->target.getWidth());
+	draw(this->batch);
+
+	// The filter applies when the layer is drawn, not twice
+	RenderTarget* previousTarget = renderer.getRenderTarget();
+	glt::vec4f previousFilter = renderer.getColorFilter();
+
+	renderer.setRenderTarget(&this->target);
+	renderer.setColorFilter({ 1, 1, 1, 1 });
+	renderer.clear(0, 0, 0, 0);
+	renderer.submit(this->batch);
+
+	renderer.setColorFilter(previousFilter);
+	renderer.setRenderTarget(previousTarget);
+
+	this->valid = true;
+	return true;
+}
+
+const xr::Rectangle<float>& xr::CachedLayer::getBounds() const
+{
+	return this->bounds;
+}
+
+void xr::CachedLayer::draw(RenderBatch & batch) const
+{
+	if (!this->valid) {
+		return;
+	}
+
+	// Alpha blending has already been applied when rendering the content
+	BlendMode blend = batch.getBlendMode();
+	batch.setBlendMode(BLEND_PREMULTIPLIED);
+
+	batch.setTexture(this->target.getTexture());
+	batch.fillRect(this->bounds.x, this->bounds.y, this->bounds.width, this->bounds.height);
+
+	batch.setBlendMode(blend);
+}
+
+bool xr::CachedLayer::covers(const Rectangle<float>& view) const
+{
+	// Zooming changes the resolution the content needs
+	if (fabsf(view.width - this->viewSize.x) > this->viewSize.x * CACHED_LAYER_ZOOM_TOLERANCE ||
+		fabsf(view.height - this->viewSize.y) > this->viewSize.y * CACHED_LAYER_ZOOM_TOLERANCE) {
+		return false;
+	}
+
+	return view.x >= this->bounds.x && view.y >= this->bounds.y &&
+		view.x + view.width <= this->bounds.x + this->bounds.width &&
+		view.y + view.height <= this->bounds.y + this->bounds.height;
+}
@@ -1,6 +1,8 @@
 #include "stdafx.h"
 #include "Camera.h"
 
+#include <limits>
+
 
 xr::Camera::Camera(glt::mat4f projection, glt::vec3f position, glt::vec3f direction, glt::vec3f up) :
 	projection(projection),
@@ -45,6 +47,39 @@ glt::vec3f xr::Camera::screenToWorld(glt::vec2f screen)
 	return result;
 }
 
+xr::Rectangle<float> xr::Camera::getViewBounds() const
+{
+	glt::mat4f inverse = glt::inverse(getTransform());
+
+	float left = std::numeric_limits<float>::max();
+	float top = std::numeric_limits<float>::max();
+	float right = -std::numeric_limits<float>::max();
+	float bottom = -std::numeric_limits<float>::max();
+
+	// Project the corners of the screen into the world
+	for (float x : { -1.0f, 1.0f }) {
+		for (float y : { -1.0f, 1.0f }) {
+			glt::vec4f corner = inverse * glt::vec4f{ x, y, -1, 1 };
+			glt::vec2f world = glt::vec2f(corner.x, corner.y) / corner.w;
+
+			left = std::min(left, world.x);
+			top = std::min(top, world.y);
+			right = std::max(right, world.x);
+			bottom = std::max(bottom, world.y);
+		}
+	}
+
+	return { left, top, right - left, bottom - top };
+}
+
+float xr::Camera::getPixelSize(glt::vec2i viewportSize) const
+{
+	Rectangle<float> bounds = this->getViewBounds();
+
+	// Pixels may not be square, smooth over the larger side
+	return std::max(bounds.width / viewportSize.x, bounds.height / viewportSize.y);
+}
+
 void xr::Camera::updateView()
 {
 	view = glt::lookAt(position, position + direction, up);
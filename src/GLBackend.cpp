@@ -0,0 +1,615 @@
+#include "stdafx.h"
+
+#include "GLBackend.h"
+#include "GLState.h"
+#include "RenderTarget.h"
+#include "StaticBatch.h"
+
+
+
+const char* vertexSource = R"(#version 330
+in vec2 position;
+// Fixed point, see PackedTexCoord
+in vec2 texCoord;
+in vec4 color;
+
+uniform mat4 camera = mat4(1.0);
+
+out FragData {
+	vec2 texCoord;
+	vec4 color;
+} frag;
+
+void main() {
+	gl_Position = camera * vec4(position, 0.0, 1.0);
+	frag.texCoord = texCoord / 8192.0 - 4.0;
+	frag.color = color;
+})";
+
+// Selects each draw's texture by its slot, read from the base instance
+const char* multiDrawVertexSource = R"(#version 430
+in vec2 position;
+// Fixed point, see PackedTexCoord
+in vec2 texCoord;
+in vec4 color;
+in uint drawSlot;
+
+uniform mat4 camera = mat4(1.0);
+
+out FragData {
+	vec2 texCoord;
+	vec4 color;
+} frag;
+
+flat out uint fragSlot;
+
+void main() {
+	gl_Position = camera * vec4(position, 0.0, 1.0);
+	frag.texCoord = texCoord / 8192.0 - 4.0;
+	frag.color = color;
+	fragSlot = drawSlot;
+})";
+
+const char* spriteVertexSource = R"(#version 330
+in vec2 spritePosition;
+in vec2 spriteSize;
+// Fixed point, see PackedTexCoord
+in vec4 spriteTexRegion;
+in vec4 spriteColor;
+in float spriteRotation;
+in uint spriteLayer;
+
+uniform mat4 camera = mat4(1.0);
+
+out FragData {
+	vec2 texCoord;
+	vec4 color;
+} frag;
+
+// Only read when sampling a texture array
+flat out float fragLayer;
+
+void main() {
+	// Corner of the quad, drawn as a triangle strip
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+	// Rotate around the center of the sprite
+	vec2 offset = (corner - 0.5) * spriteSize;
+	float c = cos(spriteRotation);
+	float s = sin(spriteRotation);
+	vec2 position = spritePosition + 0.5 * spriteSize + vec2(c * offset.x - s * offset.y, s * offset.x + c * offset.y);
+
+	gl_Position = camera * vec4(position, 0.0, 1.0);
+	vec4 region = spriteTexRegion / 8192.0 - 4.0;
+	frag.texCoord = mix(region.xy, region.zw, vec2(corner.x, 1.0 - corner.y));
+	frag.color = spriteColor;
+	fragLayer = float(spriteLayer);
+})";
+
+const char* fragmentSource = R"(#version 330
+in FragData {
+	vec2 texCoord;
+	vec4 color;
+} frag;
+
+uniform sampler2D texture0;
+uniform vec4 colorFilter;
+
+out vec4 outColor;
+
+void main() {
+	outColor = texture(texture0, frag.texCoord) * frag.color * colorFilter;
+})";
+
+// The slot is the same for a whole draw, and each draw of a multi-draw is an invocation group of its own
+// where shader draw parameters are supported, so the slot is dynamically uniform and may index the samplers
+const char* multiDrawFragmentSource = R"(#version 430
+in FragData {
+	vec2 texCoord;
+	vec4 color;
+} frag;
+
+flat in uint fragSlot;
+
+uniform sampler2D textures[16];
+uniform vec4 colorFilter;
+
+out vec4 outColor;
+
+void main() {
+	outColor = texture(textures[fragSlot], frag.texCoord) * frag.color * colorFilter;
+})";
+
+const char* arrayFragmentSource = R"(#version 330
+in FragData {
+	vec2 texCoord;
+	vec4 color;
+} frag;
+
+flat in float fragLayer;
+
+uniform sampler2DArray texture0;
+uniform vec4 colorFilter;
+
+out vec4 outColor;
+
+void main() {
+	outColor = texture(texture0, vec3(frag.texCoord, fragLayer)) * frag.color * colorFilter;
+})";
+
+
+const char* shapeVertexSource = R"(#version 330
+in vec2 shapeCenter;
+in vec2 shapeHalfSize;
+in vec3 shapeParameters;
+in vec4 shapeColor;
+
+uniform mat4 camera = mat4(1.0);
+uniform vec2 viewportSize;
+
+out ShapeData {
+	vec2 position;
+	vec4 color;
+	flat vec2 halfSize;
+	flat float radius;
+	flat float thickness;
+} shape;
+
+void main() {
+	// Corner of the quad, drawn as a triangle strip
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+
+	// Leave room for the edge to fade out over a pixel outside of the shape
+	vec2 pixelSize = 2.0 / (viewportSize * vec2(length(camera[0].xy), length(camera[1].xy)));
+	float padding = max(pixelSize.x, pixelSize.y);
+
+	// Position relative to the center, before rotation
+	vec2 position = (corner * 2.0 - 1.0) * (shapeHalfSize + padding);
+
+	float c = cos(shapeParameters.x);
+	float s = sin(shapeParameters.x);
+	vec2 world = shapeCenter + vec2(c * position.x - s * position.y, s * position.x + c * position.y);
+
+	gl_Position = camera * vec4(world, 0.0, 1.0);
+	shape.position = position;
+	shape.color = shapeColor;
+	shape.halfSize = shapeHalfSize;
+	shape.radius = shapeParameters.y;
+	shape.thickness = shapeParameters.z;
+})";
+
+const char* shapeFragmentSource = R"(#version 330
+in ShapeData {
+	vec2 position;
+	vec4 color;
+	flat vec2 halfSize;
+	flat float radius;
+	flat float thickness;
+} shape;
+
+uniform vec4 colorFilter;
+
+out vec4 outColor;
+
+// Signed distance to the edge of a box with rounded corners
+float roundedBox(vec2 position, vec2 halfSize, float radius) {
+	vec2 q = abs(position) - halfSize + radius;
+	return length(max(q, 0.0)) + min(max(q.x, q.y), 0.0) - radius;
+}
+
+void main() {
+	float distance = roundedBox(shape.position, shape.halfSize, shape.radius);
+
+	// Keep a band along the inside of the edge
+	if (shape.thickness > 0.0) {
+		distance = abs(distance + 0.5 * shape.thickness) - 0.5 * shape.thickness;
+	}
+
+	// Fade out over one pixel across the edge
+	float coverage = clamp(0.5 - distance / max(fwidth(distance), 1e-5), 0.0, 1.0);
+
+	outColor = vec4(shape.color.rgb, shape.color.a * coverage) * colorFilter;
+})";
+
+
+// Attribute locations of each kind of geometry, bound before the shaders are linked
+const std::vector<xr::AttributeBinding> vertexAttributes = {
+	{ xr::ATTR_POSITION, "position" },
+	{ xr::ATTR_TEX_COORD, "texCoord" },
+	{ xr::ATTR_COLOR, "color" },
+};
+
+const std::vector<xr::AttributeBinding> multiDrawAttributes = {
+	{ xr::ATTR_POSITION, "position" },
+	{ xr::ATTR_TEX_COORD, "texCoord" },
+	{ xr::ATTR_COLOR, "color" },
+	{ xr::ATTR_DRAW_SLOT, "drawSlot" },
+};
+
+const std::vector<xr::AttributeBinding> spriteAttributes = {
+	{ xr::ATTR_SPRITE_POSITION, "spritePosition" },
+	{ xr::ATTR_SPRITE_SIZE, "spriteSize" },
+	{ xr::ATTR_SPRITE_TEX_REGION, "spriteTexRegion" },
+	{ xr::ATTR_SPRITE_COLOR, "spriteColor" },
+	{ xr::ATTR_SPRITE_ROTATION, "spriteRotation" },
+	{ xr::ATTR_SPRITE_LAYER, "spriteLayer" },
+};
+
+const std::vector<xr::AttributeBinding> shapeAttributes = {
+	{ xr::ATTR_SHAPE_CENTER, "shapeCenter" },
+	{ xr::ATTR_SHAPE_HALF_SIZE, "shapeHalfSize" },
+	{ xr::ATTR_SHAPE_PARAMETERS, "shapeParameters" },
+	{ xr::ATTR_SHAPE_COLOR, "shapeColor" },
+};
+
+
+xr::GLBackend::GLBackend() :
+	shader(vertexSource, fragmentSource, vertexAttributes),
+	spriteShader(spriteVertexSource, fragmentSource, spriteAttributes),
+	arraySpriteShader(spriteVertexSource, arrayFragmentSource, spriteAttributes),
+	shapeShader(shapeVertexSource, shapeFragmentSource, shapeAttributes),
+	spriteBuffer(sizeof(SpriteInstance), getSpriteInstanceAttributes()),
+	shapeBuffer(sizeof(ShapeInstance), getShapeInstanceAttributes()),
+	indirectBuffer(GL_DRAW_INDIRECT_BUFFER),
+	multiDraw(false),
+	colorFilter(1, 1, 1, 1),
+	renderTarget(nullptr)
+{
+	this->uniformLocations = getUniformLocations(shader);
+	this->spriteUniformLocations = getUniformLocations(spriteShader);
+	this->arraySpriteUniformLocations = getUniformLocations(arraySpriteShader);
+	this->shapeUniformLocations = getUniformLocations(shapeShader);
+
+	// Multi-draws need base instances and indirect draws with several commands
+	// Before GL 4.6 only shader draw parameters guarantee that draws are invocation groups of their own,
+	// otherwise the samplers can't be indexed by the slot and every draw is issued on its own
+	if (GLEW_VERSION_4_3 && (GLEW_VERSION_4_6 || GLEW_ARB_shader_draw_parameters)) {
+		this->multiDrawShader.reset(new Shader(multiDrawVertexSource, multiDrawFragmentSource, multiDrawAttributes));
+
+		this->multiDrawUniformLocations = getUniformLocations(*this->multiDrawShader);
+
+		// Each slot samples the texture unit of the same number
+		GLint units[MAX_DRAW_SLOTS];
+		for (GLuint slot = 0; slot < MAX_DRAW_SLOTS; slot++) {
+			units[slot] = GLint(slot);
+		}
+
+		this->multiDrawShader->use();
+		glUniform1iv(this->multiDrawShader->getUniformLocation("textures"), MAX_DRAW_SLOTS, units);
+
+		this->multiDraw = true;
+	}
+}
+
+void xr::GLBackend::clear(glt::vec4f color)
+{
+	glClearColor(color.r, color.g, color.b, color.a);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void xr::GLBackend::submit(const DrawList & list, const glt::mat4f & transformation, glt::vec4f colorFilter, const char * label)
+{
+	this->colorFilter = colorFilter;
+	this->profiler.beginSubmit(label);
+
+	// Make room for every source first, so that streaming one can't replace or fence what the others wrote
+	size_t vertices = 0, indices = 0, sprites = 0, shapes = 0;
+	for (const DrawList::Source& source : list.sources) {
+		vertices += source.vertices->size();
+		indices += source.indices->size();
+		sprites += source.sprites->size();
+		shapes += source.shapes->size();
+	}
+
+	this->vertexBuffer.reserve(vertices, indices, list.sources.size());
+	this->spriteBuffer.reserve(sprites, list.sources.size());
+	this->shapeBuffer.reserve(shapes, list.sources.size());
+
+	// Write each source's geometry into this frame's part of the stream at once
+	this->sourceLocations.clear();
+	for (const DrawList::Source& source : list.sources) {
+		SourceLocation location;
+		location.range = this->vertexBuffer.stream(*source.vertices, *source.indices);
+		location.spriteOffset = this->spriteBuffer.stream(source.sprites->data(), source.sprites->size());
+		location.shapeOffset = this->shapeBuffer.stream(source.shapes->data(), source.shapes->size());
+		this->sourceLocations.push_back(location);
+
+		this->profiler.countUpload(source.vertices->size(),
+								   source.vertices->size() * sizeof(Vertex) +
+								   source.indices->size() * sizeof(GLushort) +
+								   source.sprites->size() * sizeof(SpriteInstance) +
+								   source.shapes->size() * sizeof(ShapeInstance));
+	}
+
+	DrawBuffers buffers = { this->vertexBuffer, this->spriteBuffer, this->shapeBuffer };
+	this->issueDraws(list.draws, transformation, buffers, this->sourceLocations.data());
+
+	this->profiler.endSubmit();
+}
+
+void xr::GLBackend::submit(StaticBatch & batch, const glt::mat4f & transformation, glt::vec4f colorFilter, const char * label)
+{
+	this->colorFilter = colorFilter;
+	this->profiler.beginSubmit(label);
+
+	// All geometry starts at the beginning of the batch's buffers
+	SourceLocation location = { { 0, 0 }, 0, 0 };
+
+	DrawBuffers buffers = { batch.vertexBuffer, batch.spriteBuffer, batch.shapeBuffer };
+	this->issueDraws(batch.draws, transformation, buffers, &location);
+
+	this->profiler.endSubmit();
+}
+
+void xr::GLBackend::endFrame()
+{
+	this->vertexBuffer.endFrame();
+	this->spriteBuffer.endFrame();
+	this->shapeBuffer.endFrame();
+	this->indirectBuffer.endFrame();
+
+	this->profiler.endFrame();
+}
+
+void xr::GLBackend::setGpuTiming(bool enabled)
+{
+	this->profiler.setTiming(enabled);
+}
+
+const xr::FrameStats & xr::GLBackend::getFrameStats() const
+{
+	return this->profiler.getFrameStats();
+}
+
+void xr::GLBackend::setMultiDraw(bool enabled)
+{
+	this->multiDraw = enabled && this->multiDrawShader;
+}
+
+bool xr::GLBackend::supportsMultiDraw() const
+{
+	return this->multiDrawShader != nullptr;
+}
+
+void xr::GLBackend::setRenderTarget(RenderTarget * target)
+{
+	if (target == this->renderTarget) {
+		return;
+	}
+
+	// Remember the window's viewport while drawing elsewhere
+	if (!this->renderTarget) {
+		std::copy(GLState::get().getViewport(), GLState::get().getViewport() + 4, this->windowViewport);
+	}
+
+	this->renderTarget = target;
+
+	if (target) {
+		target->bind();
+		GLState::get().setViewport(0, 0, target->getWidth(), target->getHeight());
+	}
+	else {
+		RenderTarget::bindDefault();
+		GLState::get().setViewport(this->windowViewport[0], this->windowViewport[1], this->windowViewport[2], this->windowViewport[3]);
+	}
+}
+
+void xr::GLBackend::issueDraws(const std::vector<DrawList::Draw>& draws, const glt::mat4f & transformation,
+							   const DrawBuffers & buffers, const SourceLocation * locations)
+{
+	Shader* currentShader = nullptr;
+
+	// Texture batches start whenever the sampled texture changes
+	bool firstDraw = true;
+	GLuint currentTexture = 0;
+
+	const GLint* viewport = GLState::get().getViewport();
+	this->viewportSize = { float(viewport[2]), float(viewport[3]) };
+
+	for (size_t i = 0; i < draws.size(); i++) {
+		const DrawList::Draw& draw = draws[i];
+
+		// Merge runs of meshes or quads into one call where possible
+		if (this->multiDraw && (draw.type == DRAW_MESH || draw.type == DRAW_QUADS)) {
+			size_t last = this->findMultiDrawRun(draws, i);
+			if (last - i > 1) {
+				if (this->multiDrawShader.get() != currentShader) {
+					this->multiDrawShader->use();
+					this->applyUniforms(this->multiDrawUniformLocations, transformation);
+					currentShader = this->multiDrawShader.get();
+					this->profiler.countShaderSwitch();
+				}
+
+				this->issueMultiDraw(draws, i, last, buffers, locations);
+
+				// The next draw starts a texture batch of its own
+				firstDraw = true;
+				i = last - 1;
+				continue;
+			}
+		}
+
+		// Find the shader for the type of geometry
+		Shader* shader;
+		const UniformLocations* uniforms;
+		switch (draw.type) {
+		case DRAW_MESH:
+		case DRAW_QUADS: shader = &this->shader; uniforms = &this->uniformLocations; break;
+		case DRAW_SPRITES: shader = &this->spriteShader; uniforms = &this->spriteUniformLocations; break;
+		case DRAW_ARRAY_SPRITES: shader = &this->arraySpriteShader; uniforms = &this->arraySpriteUniformLocations; break;
+		default: shader = &this->shapeShader; uniforms = &this->shapeUniformLocations; break;
+		}
+
+		// Uniforms only change when the shader does, the GL state skips redundant binds
+		if (shader != currentShader) {
+			shader->use();
+			this->applyUniforms(*uniforms, transformation);
+			currentShader = shader;
+			this->profiler.countShaderSwitch();
+		}
+
+		GLuint texture = draw.type == DRAW_ARRAY_SPRITES ? draw.textureArray.getHandle() : draw.texture.getHandle();
+		if (firstDraw || texture != currentTexture) {
+			this->profiler.beginTextureBatch(texture);
+			currentTexture = texture;
+			firstDraw = false;
+		}
+
+		applyBlendMode(draw.blend);
+
+		const SourceLocation& location = locations[draw.source];
+
+		switch (draw.type) {
+		case DRAW_MESH:
+			draw.texture.bind();
+			buffers.vertices.drawElements(draw.count, location.range.firstIndex + draw.first, location.range.baseVertex + draw.baseVertex);
+			this->profiler.countDraw(draw.count, 0);
+			break;
+
+		case DRAW_QUADS:
+			draw.texture.bind();
+			buffers.vertices.drawQuads(draw.count / 4, location.range.baseVertex + draw.first);
+
+			// Long runs of quads are split into several draws
+			for (GLuint quad = 0; quad < draw.count / 4; quad += MAX_QUADS_PER_DRAW) {
+				this->profiler.countDraw(std::min(draw.count / 4 - quad, MAX_QUADS_PER_DRAW) * 6, 0);
+			}
+			break;
+
+		case DRAW_SPRITES:
+		case DRAW_ARRAY_SPRITES:
+			if (draw.type == DRAW_ARRAY_SPRITES) {
+				draw.textureArray.bind();
+			}
+			else {
+				draw.texture.bind();
+			}
+
+			// Expand one instance into a quad per sprite
+			buffers.sprites.drawInstanced(draw.count, location.spriteOffset + draw.first * sizeof(SpriteInstance));
+			this->profiler.countDraw(0, draw.count);
+			break;
+
+		case DRAW_SHAPES:
+			// Shapes are not textured
+			buffers.shapes.drawInstanced(draw.count, location.shapeOffset + draw.first * sizeof(ShapeInstance));
+			this->profiler.countDraw(0, draw.count);
+			break;
+		}
+	}
+
+	// Leave the default blend mode for whoever draws next
+	applyBlendMode(BLEND_ALPHA);
+}
+
+size_t xr::GLBackend::findMultiDrawRun(const std::vector<DrawList::Draw>& draws, size_t first)
+{
+	const DrawList::Draw& start = draws[first];
+	this->slotTextures.clear();
+
+	size_t last = first;
+	for (; last < draws.size(); last++) {
+		const DrawList::Draw& draw = draws[last];
+		if (draw.type != start.type || draw.blend != start.blend) {
+			break;
+		}
+
+		// Every texture needs a slot of its own
+		GLuint texture = draw.texture.getHandle();
+		if (std::find(this->slotTextures.begin(), this->slotTextures.end(), texture) == this->slotTextures.end()) {
+			if (this->slotTextures.size() == MAX_DRAW_SLOTS) {
+				break;
+			}
+			this->slotTextures.push_back(texture);
+		}
+	}
+
+	return last;
+}
+
+void xr::GLBackend::issueMultiDraw(const std::vector<DrawList::Draw>& draws, size_t first, size_t last,
+								   const DrawBuffers & buffers, const SourceLocation * locations)
+{
+	bool quads = draws[first].type == DRAW_QUADS;
+
+	this->indirectCommands.clear();
+	size_t indices = 0;
+
+	for (size_t i = first; i < last; i++) {
+		const DrawList::Draw& draw = draws[i];
+		const SourceLocation& location = locations[draw.source];
+
+		// The run was found with the same textures, so every texture has a slot
+		GLuint slot = GLuint(std::find(this->slotTextures.begin(), this->slotTextures.end(), draw.texture.getHandle()) - this->slotTextures.begin());
+
+		if (quads) {
+			// Long runs of quads are split into several commands, like drawQuads does
+			for (GLuint quad = 0; quad < draw.count / 4; quad += MAX_QUADS_PER_DRAW) {
+				GLuint count = std::min(draw.count / 4 - quad, MAX_QUADS_PER_DRAW) * 6;
+				this->indirectCommands.push_back({ count, 1, 0, GLint(location.range.baseVertex + draw.first + quad * 4), slot });
+				indices += count;
+			}
+		}
+		else {
+			this->indirectCommands.push_back({ draw.count, 1, location.range.firstIndex + draw.first,
+											   GLint(location.range.baseVertex + draw.baseVertex), slot });
+			indices += draw.count;
+		}
+	}
+
+	// Start streaming on first use
+	if (!this->indirectBuffer.isStreaming()) {
+		this->indirectBuffer.allocateStream(MAX_DRAW_SLOTS * 64 * sizeof(DrawElementsIndirectCommand));
+	}
+
+	GLsizeiptr bytes = this->indirectCommands.size() * sizeof(DrawElementsIndirectCommand);
+	GLintptr offset = this->indirectBuffer.stream(this->indirectCommands.data(), bytes, sizeof(GLuint));
+	this->profiler.countUpload(0, bytes);
+
+	// A multi-draw samples several textures, it is a texture batch of its own, timed from before the draw
+	this->profiler.beginTextureBatch(0);
+
+	for (GLuint slot = 0; slot < this->slotTextures.size(); slot++) {
+		GLState::get().bindTexture(GL_TEXTURE_2D, this->slotTextures[slot], slot);
+	}
+
+	applyBlendMode(draws[first].blend);
+
+	this->indirectBuffer.bind();
+	buffers.vertices.multiDrawIndirect(offset, GLsizei(this->indirectCommands.size()), quads);
+
+	this->profiler.countMultiDraw(indices, int(this->indirectCommands.size()));
+}
+
+xr::GLBackend::UniformLocations xr::GLBackend::getUniformLocations(Shader & shader)
+{
+	UniformLocations locations;
+	locations.cameraMatrix = shader.getUniformLocation("camera");
+	locations.texture0 = shader.getUniformLocation("texture0");
+	locations.colorFilter = shader.getUniformLocation("colorFilter");
+	locations.viewportSize = shader.getUniformLocation("viewportSize");
+	return locations;
+}
+
+void xr::GLBackend::applyUniforms(const UniformLocations & locations, const glt::mat4f & transformation)
+{
+	// Upload transformation
+	glUniformMatrix4fv(locations.cameraMatrix, 1, 0, transformation.data);
+
+	// Apply filters
+	glUniform4f(locations.colorFilter, colorFilter.r, colorFilter.g, colorFilter.b, colorFilter.a);
+
+	// Let shaders find the size of a pixel
+	glUniform2f(locations.viewportSize, this->viewportSize.x, this->viewportSize.y);
+}
+
+void xr::GLBackend::applyBlendMode(BlendMode mode)
+{
+	switch (mode) {
+	// Alpha is accumulated so that render targets end up with premultiplied colors
+	case BLEND_ALPHA: GLState::get().setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA); break;
+	case BLEND_ADDITIVE: GLState::get().setBlendFunc(GL_SRC_ALPHA, GL_ONE, GL_ZERO, GL_ONE); break;
+	case BLEND_MULTIPLY: GLState::get().setBlendFunc(GL_DST_COLOR, GL_ZERO, GL_ZERO, GL_ONE); break;
+	case BLEND_PREMULTIPLIED: GLState::get().setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA); break;
+	}
+}
@@ -0,0 +1,206 @@
+#include "stdafx.h"
+#include "GLState.h"
+
+
+// A binding that isn't known
+const GLuint UNKNOWN = ~0u;
+
+
+xr::GLState::GLState()
+{
+	this->invalidate();
+}
+
+xr::GLState & xr::GLState::get()
+{
+	// A context is only ever current on one thread
+	static thread_local GLState state;
+	return state;
+}
+
+void xr::GLState::useProgram(GLuint program)
+{
+	if (this->change(this->program, program)) {
+		glUseProgram(program);
+	}
+}
+
+void xr::GLState::bindVertexArray(GLuint vertexArray)
+{
+	if (this->change(this->vertexArray, vertexArray)) {
+		glBindVertexArray(vertexArray);
+
+		// Each vertex array has its own element array buffer
+		find(this->buffers, GL_ELEMENT_ARRAY_BUFFER) = UNKNOWN;
+	}
+}
+
+void xr::GLState::bindBuffer(GLenum target, GLuint buffer)
+{
+	if (this->change(find(this->buffers, target), buffer)) {
+		glBindBuffer(target, buffer);
+	}
+}
+
+void xr::GLState::bindTexture(GLenum target, GLuint texture, GLuint unit)
+{
+	if (unit >= this->textures.size()) {
+		this->textures.resize(unit + 1);
+	}
+
+	// The unit is made active even if the texture is bound already, calls editing the bound texture act on it
+	if (this->change(this->activeTextureUnit, unit)) {
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+
+	if (this->change(find(this->textures[unit], target), texture)) {
+		glBindTexture(target, texture);
+	}
+}
+
+void xr::GLState::bindFramebuffer(GLuint framebuffer)
+{
+	if (this->change(this->framebuffer, framebuffer)) {
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	}
+}
+
+void xr::GLState::setViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (this->viewportKnown && this->viewport[0] == x && this->viewport[1] == y &&
+		this->viewport[2] == width && this->viewport[3] == height) {
+		this->stats.avoided++;
+		return;
+	}
+
+	this->viewport[0] = x;
+	this->viewport[1] = y;
+	this->viewport[2] = width;
+	this->viewport[3] = height;
+	this->viewportKnown = true;
+	this->stats.issued++;
+	glViewport(x, y, width, height);
+}
+
+const GLint * xr::GLState::getViewport()
+{
+	// Querying stalls threaded drivers, so only do it once
+	if (!this->viewportKnown) {
+		glGetIntegerv(GL_VIEWPORT, this->viewport);
+		this->viewportKnown = true;
+	}
+
+	return this->viewport;
+}
+
+void xr::GLState::setBlendFunc(GLenum source, GLenum destination)
+{
+	this->setBlendFunc(source, destination, source, destination);
+}
+
+void xr::GLState::setBlendFunc(GLenum source, GLenum destination, GLenum sourceAlpha, GLenum destinationAlpha)
+{
+	if (this->blendSource == source && this->blendDestination == destination &&
+		this->blendSourceAlpha == sourceAlpha && this->blendDestinationAlpha == destinationAlpha) {
+		this->stats.avoided++;
+		return;
+	}
+
+	this->blendSource = source;
+	this->blendDestination = destination;
+	this->blendSourceAlpha = sourceAlpha;
+	this->blendDestinationAlpha = destinationAlpha;
+	this->stats.issued++;
+	glBlendFuncSeparate(source, destination, sourceAlpha, destinationAlpha);
+}
+
+void xr::GLState::forgetProgram(GLuint program)
+{
+	if (this->program == program) {
+		this->program = UNKNOWN;
+	}
+}
+
+void xr::GLState::forgetVertexArray(GLuint vertexArray)
+{
+	if (this->vertexArray == vertexArray) {
+		this->vertexArray = UNKNOWN;
+		find(this->buffers, GL_ELEMENT_ARRAY_BUFFER) = UNKNOWN;
+	}
+}
+
+void xr::GLState::forgetBuffer(GLuint buffer)
+{
+	for (auto& binding : this->buffers) {
+		if (binding.second == buffer) {
+			binding.second = UNKNOWN;
+		}
+	}
+}
+
+void xr::GLState::forgetTexture(GLuint texture)
+{
+	for (auto& unit : this->textures) {
+		for (auto& binding : unit) {
+			if (binding.second == texture) {
+				binding.second = UNKNOWN;
+			}
+		}
+	}
+}
+
+void xr::GLState::forgetFramebuffer(GLuint framebuffer)
+{
+	if (this->framebuffer == framebuffer) {
+		this->framebuffer = UNKNOWN;
+	}
+}
+
+void xr::GLState::invalidate()
+{
+	this->program = UNKNOWN;
+	this->vertexArray = UNKNOWN;
+	this->framebuffer = UNKNOWN;
+	this->buffers.clear();
+	this->textures.clear();
+	this->activeTextureUnit = UNKNOWN;
+	this->viewportKnown = false;
+	this->blendSource = UNKNOWN;
+	this->blendDestination = UNKNOWN;
+	this->blendSourceAlpha = UNKNOWN;
+	this->blendDestinationAlpha = UNKNOWN;
+}
+
+const xr::GLStateStats & xr::GLState::getStats() const
+{
+	return this->stats;
+}
+
+void xr::GLState::resetStats()
+{
+	this->stats = GLStateStats();
+}
+
+bool xr::GLState::change(GLuint & current, GLuint value)
+{
+	if (current == value) {
+		this->stats.avoided++;
+		return false;
+	}
+
+	current = value;
+	this->stats.issued++;
+	return true;
+}
+
+GLuint & xr::GLState::find(std::vector<std::pair<GLenum, GLuint>>& bindings, GLenum target)
+{
+	for (auto& binding : bindings) {
+		if (binding.first == target) {
+			return binding.second;
+		}
+	}
+
+	bindings.emplace_back(target, UNKNOWN);
+	return bindings.back().second;
+}
@@ -6,6 +6,8 @@
 #include "Collision.h"
 
 #include "Image.h"
+#include "JobSystem.h"
+#include "Trace.h"
 
 xr::Image::Image(int width, int height)
 {
@@ -60,6 +62,8 @@ void xr::Image::blit(const Image & image, int x, int y)
 
 void xr::Image::decode(ImageFormat format, unsigned char * data, size_t dataSize)
 {
+	XR_TRACE_SCOPE("Image::decode");
+
 	if (format == DONT_KNOW) {
 		format = getFormatFromBytes(data, dataSize);
 	}
@@ -110,6 +114,8 @@ xr::Image::Image(unsigned char *data, int width, int height) :
 
 std::vector<xr::ImageRegion> xr::stitchImages(Image& result, const std::vector<const Image*>& images)
 {
+	XR_TRACE_SCOPE("stitchImages");
+
 	typedef std::pair<int, glt::vec2i> IndexPair;
 
 	std::vector<IndexPair> imageSizes;
@@ -267,10 +273,14 @@ std::vector<xr::ImageRegion> xr::stitchImages(Image& result, const std::vector<c
 
 	std::vector<ImageRegion> regions(images.size());
 
-	for (IndexPair& index : bestRectangle.locations)
-	{
+	// The images don't overlap, so they can be copied at the same time
+	JobSystem::get().parallelFor(int(bestRectangle.locations.size()), [&](int i) {
+		const IndexPair& index = bestRectangle.locations[i];
 		result.blit(*images[index.first], index.second.x, index.second.y);
+	});
 
+	for (IndexPair& index : bestRectangle.locations)
+	{
 		regions[index.first].x = index.second.x;
 		regions[index.first].y = index.second.y;
 		regions[index.first].width = images[index.first]->getWidth();
@@ -0,0 +1,350 @@
+#include "stdafx.h"
+#include "JobSystem.h"
+#include "Trace.h"
+
+
+// Number of times a waiting thread looks for tasks before going to sleep
+const int WAIT_SPIN_COUNT = 64;
+
+namespace {
+
+	// The job system whose worker is running on this thread, if any, and the worker's queue
+	thread_local const xr::JobSystem* currentSystem = nullptr;
+	thread_local size_t currentQueue = 0;
+
+}
+
+
+xr::TaskGraph::Task xr::TaskGraph::add(std::function<void()> work, std::initializer_list<Task> dependencies)
+{
+	Task task = this->nodes.size();
+	this->nodes.emplace_back();
+	this->nodes.back().work = std::move(work);
+
+	for (Task dependency : dependencies) {
+		this->addDependency(task, dependency);
+	}
+
+	return task;
+}
+
+void xr::TaskGraph::addDependency(Task task, Task dependency)
+{
+	this->nodes[dependency].successors.push_back(task);
+	this->nodes[task].dependencies++;
+}
+
+size_t xr::TaskGraph::size() const
+{
+	return this->nodes.size();
+}
+
+
+
+xr::JobSystem::JobSystem(int threads) :
+	queued(0),
+	stopping(false)
+{
+	if (threads <= 0) {
+		threads = std::max(1, int(std::thread::hardware_concurrency()) - 1);
+	}
+
+	// One queue per worker and one shared by everyone else
+	for (int i = 0; i <= threads; i++) {
+		this->queues.emplace_back(new Queue());
+	}
+
+	for (int i = 0; i < threads; i++) {
+		this->workers.emplace_back(&JobSystem::work, this, size_t(i));
+	}
+}
+
+xr::JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->sleepMutex);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+
+	for (std::thread& worker : this->workers) {
+		worker.join();
+	}
+}
+
+xr::JobSystem & xr::JobSystem::get()
+{
+	static JobSystem system;
+	return system;
+}
+
+int xr::JobSystem::getThreadCount() const
+{
+	return int(this->workers.size());
+}
+
+void xr::JobSystem::parallelFor(int count, const std::function<void(int)>& work, int grain)
+{
+	if (count <= 0) {
+		return;
+	}
+
+	// A few runs per thread leave room to balance uneven work
+	if (grain <= 0) {
+		grain = std::max(1, count / (4 * (this->getThreadCount() + 1)));
+	}
+
+	int runs = (count + grain - 1) / grain;
+	if (runs == 1) {
+		for (int i = 0; i < count; i++) {
+			work(i);
+		}
+		return;
+	}
+
+	XR_TRACE_SCOPE("JobSystem::parallelFor");
+
+	Batch batch;
+	batch.remaining = runs;
+	batch.failed = false;
+
+	for (int run = 0; run < runs; run++) {
+		int first = run * grain;
+		int last = std::min(first + grain, count);
+
+		Task* task = new Task{ [&work, first, last]() {
+			for (int i = first; i < last; i++) {
+				work(i);
+			}
+		}, nullptr, 0, &batch };
+
+		this->push(task);
+	}
+
+	this->wait(batch);
+}
+
+void xr::JobSystem::run(TaskGraph & graph)
+{
+	if (graph.nodes.empty()) {
+		return;
+	}
+
+	XR_TRACE_SCOPE("JobSystem::run");
+
+	Batch batch;
+	batch.remaining = int(graph.nodes.size());
+	batch.failed = false;
+
+	for (TaskGraph::Node& node : graph.nodes) {
+		node.remaining = node.dependencies;
+	}
+
+	for (size_t node = 0; node < graph.nodes.size(); node++) {
+		if (graph.nodes[node].dependencies == 0) {
+			this->push(new Task{ {}, &graph, node, &batch });
+		}
+	}
+
+	this->wait(batch);
+}
+
+void xr::JobSystem::post(std::function<void()> work)
+{
+	this->push(new Task{ std::move(work), nullptr, 0, nullptr });
+}
+
+void xr::JobSystem::runOnContextThread(std::function<void()> work)
+{
+	std::lock_guard<std::mutex> lock(this->contextMutex);
+	this->contextJobs.push_back(std::move(work));
+}
+
+void xr::JobSystem::runContextJobs()
+{
+	std::vector<std::function<void()>> jobs;
+	{
+		std::lock_guard<std::mutex> lock(this->contextMutex);
+		jobs.swap(this->contextJobs);
+	}
+
+	for (std::function<void()>& job : jobs) {
+		job();
+	}
+}
+
+void xr::JobSystem::push(Task * task)
+{
+	Queue& queue = *this->queues[currentSystem == this ? currentQueue : this->queues.size() - 1];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(task);
+	}
+
+	this->queued++;
+
+	// Taking the lock keeps a worker from missing the task between checking for work and going to sleep
+	{
+		std::lock_guard<std::mutex> lock(this->sleepMutex);
+	}
+	this->wake.notify_one();
+
+	// Waiting threads help with the task too
+	this->waiting.notify_one();
+}
+
+xr::JobSystem::Task * xr::JobSystem::take()
+{
+	if (this->queued == 0) {
+		return nullptr;
+	}
+
+	size_t count = this->queues.size();
+	size_t own = currentSystem == this ? currentQueue : count - 1;
+
+	// Workers take their newest task, whose data is most likely still in the cache
+	if (own != count - 1) {
+		Queue& queue = *this->queues[own];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			Task* task = queue.tasks.back();
+			queue.tasks.pop_back();
+			this->queued--;
+			return task;
+		}
+	}
+
+	// Steal the oldest task of another queue, starting with the one before this thread's own
+	// so thieves spread over the queues, the shared queue is visited along the way
+	for (size_t i = 0; i < count; i++) {
+		size_t victim = (own + count - 1 - i) % count;
+		if (victim == own && own != count - 1) {
+			continue;
+		}
+
+		Queue& queue = *this->queues[victim];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.tasks.empty()) {
+			Task* task = queue.tasks.front();
+			queue.tasks.pop_front();
+			this->queued--;
+			return task;
+		}
+	}
+
+	return nullptr;
+}
+
+bool xr::JobSystem::runOne()
+{
+	Task* task = this->take();
+	if (!task) {
+		return false;
+	}
+
+	// Nobody waits for a posted task, so nobody could handle what it throws
+	if (!task->batch) {
+		try {
+			task->work();
+		}
+		catch (...) {
+			std::terminate();
+		}
+
+		delete task;
+		return true;
+	}
+
+	Batch& batch = *task->batch;
+
+	try {
+		if (!batch.failed) {
+			if (task->graph) {
+				task->graph->nodes[task->node].work();
+			}
+			else {
+				task->work();
+			}
+		}
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(batch.errorMutex);
+		if (!batch.error) {
+			batch.error = std::current_exception();
+		}
+		batch.failed = true;
+	}
+
+	// Successors are scheduled even if the task failed, so that every task of the batch finishes
+	if (task->graph) {
+		this->finishNode(*task->graph, task->node, batch);
+	}
+
+	delete task;
+
+	// The batch may go away as soon as this reaches zero
+	if (--batch.remaining == 0) {
+		{
+			std::lock_guard<std::mutex> lock(this->sleepMutex);
+		}
+		this->waiting.notify_all();
+	}
+
+	return true;
+}
+
+void xr::JobSystem::wait(Batch & batch)
+{
+	int idle = 0;
+	while (batch.remaining > 0) {
+		if (this->runOne()) {
+			idle = 0;
+			continue;
+		}
+
+		// The tasks are running elsewhere, and may take a while
+		if (++idle < WAIT_SPIN_COUNT) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		XR_TRACE_SCOPE("JobSystem::wait");
+
+		std::unique_lock<std::mutex> lock(this->sleepMutex);
+		this->waiting.wait(lock, [this, &batch]() { return batch.remaining == 0 || this->queued > 0; });
+		idle = 0;
+	}
+
+	if (batch.error) {
+		std::rethrow_exception(batch.error);
+	}
+}
+
+void xr::JobSystem::finishNode(TaskGraph & graph, size_t node, Batch & batch)
+{
+	for (size_t successor : graph.nodes[node].successors) {
+		if (--graph.nodes[successor].remaining == 0) {
+			this->push(new Task{ {}, &graph, successor, &batch });
+		}
+	}
+}
+
+void xr::JobSystem::work(size_t queue)
+{
+	currentSystem = this;
+	currentQueue = queue;
+
+	while (true) {
+		if (this->runOne()) {
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(this->sleepMutex);
+		this->wake.wait(lock, [this]() { return this->queued > 0 || this->stopping; });
+
+		// Posted tasks are finished before stopping
+		if (this->stopping && this->queued == 0) {
+			break;
+		}
+	}
+}
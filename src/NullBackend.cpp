@@ -0,0 +1,99 @@
+#include "stdafx.h"
+#include "NullBackend.h"
+#include "StaticBatch.h"
+
+
+xr::NullBackend::NullBackend() :
+	clears(0)
+{
+}
+
+void xr::NullBackend::clear(glt::vec4f /*color*/)
+{
+	this->clears++;
+}
+
+void xr::NullBackend::submit(const DrawList & list, const glt::mat4f & /*transformation*/, glt::vec4f /*colorFilter*/, const char * label)
+{
+	this->profiler.beginSubmit(label);
+
+	// Count the bytes a GL backend would stream
+	for (const DrawList::Source& source : list.sources) {
+		this->profiler.countUpload(source.vertices->size(),
+								   source.vertices->size() * sizeof(Vertex) +
+								   source.indices->size() * sizeof(GLushort) +
+								   source.sprites->size() * sizeof(SpriteInstance) +
+								   source.shapes->size() * sizeof(ShapeInstance));
+	}
+
+	this->countDraws(list.draws);
+
+	this->profiler.endSubmit();
+}
+
+void xr::NullBackend::submit(StaticBatch & batch, const glt::mat4f & /*transformation*/, glt::vec4f /*colorFilter*/, const char * label)
+{
+	// The geometry was uploaded once already
+	this->profiler.beginSubmit(label);
+	this->countDraws(batch.getDraws());
+	this->profiler.endSubmit();
+}
+
+void xr::NullBackend::setRenderTarget(RenderTarget * /*target*/)
+{
+}
+
+void xr::NullBackend::endFrame()
+{
+	this->profiler.endFrame();
+}
+
+const xr::FrameStats & xr::NullBackend::getFrameStats() const
+{
+	return this->profiler.getFrameStats();
+}
+
+size_t xr::NullBackend::getClearCount() const
+{
+	return this->clears;
+}
+
+void xr::NullBackend::countDraws(const std::vector<DrawList::Draw>& draws)
+{
+	// Mirrors the draw loop of the GL backend: meshes and quads share a shader, the others have their own
+	int currentShader = -1;
+
+	bool firstDraw = true;
+	GLuint currentTexture = 0;
+
+	for (const DrawList::Draw& draw : draws) {
+		int shader = draw.type == DRAW_QUADS ? int(DRAW_MESH) : int(draw.type);
+		if (shader != currentShader) {
+			currentShader = shader;
+			this->profiler.countShaderSwitch();
+		}
+
+		GLuint texture = draw.type == DRAW_ARRAY_SPRITES ? draw.textureArray.getHandle() : draw.texture.getHandle();
+		if (firstDraw || texture != currentTexture) {
+			this->profiler.beginTextureBatch(texture);
+			currentTexture = texture;
+			firstDraw = false;
+		}
+
+		switch (draw.type) {
+		case DRAW_MESH:
+			this->profiler.countDraw(draw.count, 0);
+			break;
+
+		case DRAW_QUADS:
+			for (GLuint quad = 0; quad < draw.count / 4; quad += MAX_QUADS_PER_DRAW) {
+				this->profiler.countDraw(std::min(draw.count / 4 - quad, MAX_QUADS_PER_DRAW) * 6, 0);
+			}
+			break;
+
+		default:
+			this->profiler.countDraw(0, draw.count);
+			break;
+		}
+	}
+}
@@ -2,39 +2,150 @@
 #include "RenderBatch.h"
 
 #include "VectorMath.h"
+#include "Utility.h"
+#include "Buffer.h"
 
 #include "Constants.h"
 
+
+// Bits of a sort key, from most to least significant:
+// layer (16) | order (24) | type (3) | blend mode (2) | texture (19)
+const int KEY_LAYER_SHIFT = 48;
+const int KEY_ORDER_SHIFT = 24;
+const int KEY_TYPE_SHIFT = 21;
+const int KEY_BLEND_SHIFT = 19;
+
+const uint64_t KEY_ORDER_MASK = 0xffffffull << KEY_ORDER_SHIFT;
+const uint64_t KEY_TEXTURE_MASK = 0x7ffff;
+
+
+// Most commands recorded in submission order by a batch and its sub-batches
+const size_t MAX_SEQUENCED_COMMANDS = 0xffffff;
+
+// Most sub-batches a batch can have, limited by the bits available in sort values
+const size_t MAX_SUB_BATCHES = 255;
+
+// Bits of a sort value: batch (8) | command (24)
+const int VALUE_BATCH_SHIFT = 24;
+const uint32_t VALUE_COMMAND_MASK = 0xffffff;
+
+
 xr::RenderBatch::RenderBatch() :
-	defaultTexture(1, 1, GL_RGBA, new unsigned char[4]{255, 255, 255, 255}),
-	currentTextureRegion(0, 0, 1, 1)
+	RenderBatch(Texture(1, 1, GL_RGBA, new unsigned char[4]{255, 255, 255, 255}))
+{
+}
+
+xr::RenderBatch::RenderBatch(const Texture & defaultTexture) :
+	usingTextureArray(false),
+	currentArrayLayer(0),
+	blendMode(BLEND_ALPHA),
+	sortMode(SORT_SUBMISSION),
+	layer(0),
+	depth(0),
+	defaultTexture(defaultTexture),
+	culling(false),
+	viewBounds(0, 0, 0, 0),
+	pixelSize(0),
+	parent(nullptr)
 {
 	this->clearTexture();
 }
 
 void xr::RenderBatch::begin(const glt::mat4f &transformation) {
-    // TODO: Keep capacity of meshes
-    this->textureBatches.clear();
+    // Keep the capacity from the previous frame
+    this->mesh.vertices.clear();
+    this->mesh.indices.clear();
+    this->sprites.clear();
+    this->shapes.clear();
+    this->commands.clear();
 
     this->transformation = transformation;
-    this->fillColor = { 1.0, 1.0, 1.0, 1.0 };
+    this->fillColor = PackedColor();
+
+    // Only a camera tells what is visible
+    this->culling = false;
+    this->cullStats = CullStats();
+
+    this->blendMode = BLEND_ALPHA;
+    this->sortMode = SORT_SUBMISSION;
+    this->layer = 0;
+    this->depth = 0;
 
     this->clearTexture();
+
+    for (auto& subBatch : this->subBatches) {
+        subBatch->begin(transformation);
+    }
 }
 
 void xr::RenderBatch::begin(const xr::Camera &camera) {
     begin(camera.getTransform());
+
+    this->viewBounds = camera.getViewBounds();
+    this->setCulling(true);
+}
+
+void xr::RenderBatch::setCulling(bool enabled)
+{
+	this->culling = enabled;
+
+	for (auto& subBatch : this->subBatches) {
+		subBatch->viewBounds = this->viewBounds;
+		subBatch->culling = enabled;
+	}
+}
+
+xr::CullStats xr::RenderBatch::getCullStats() const
+{
+	CullStats total = this->cullStats;
+
+	for (auto& subBatch : this->subBatches) {
+		total.tested += subBatch->cullStats.tested;
+		total.culled += subBatch->cullStats.culled;
+	}
+
+	return total;
+}
+
+xr::RenderBatch & xr::RenderBatch::getSubBatch(size_t index)
+{
+	// Sub-batches of sub-batches would never be compiled
+	if (this->parent) {
+		return this->parent->getSubBatch(index);
+	}
+
+	if (index >= MAX_SUB_BATCHES) {
+		throw std::runtime_error("Sub-batch index out of range");
+	}
+
+	std::lock_guard<std::mutex> lock(this->subBatchMutex);
+
+	// Create the sub-batches before it too, empty ones draw nothing
+	while (this->subBatches.size() <= index) {
+		this->subBatches.emplace_back(new RenderBatch(this->defaultTexture));
+		RenderBatch& subBatch = *this->subBatches.back();
+		subBatch.parent = this;
+		subBatch.begin(this->transformation);
+		subBatch.viewBounds = this->viewBounds;
+		subBatch.culling = this->culling;
+		subBatch.pixelSize = this->pixelSize;
+	}
+
+	return *this->subBatches[index];
 }
 
 void xr::RenderBatch::setFillColor(glt::vec4f color)
 {
-	this->fillColor = color;
+	this->fillColor = PackedColor(color);
 }
 
 void xr::RenderBatch::setTexture(const Texture & texture, const Rectangle<float>& region)
 {
-    currentTextureBatch = & textureBatches[texture];
-    currentTextureRegion = region;
+    currentTexture = texture;
+    usingTextureArray = false;
+    currentArrayLayer = 0;
+
+    setTextureRegion(region);
 }
 
 void xr::RenderBatch::setTexture(const TextureRegion & region)
@@ -42,163 +153,227 @@ void xr::RenderBatch::setTexture(const TextureRegion & region)
 	this->setTexture(region.getTexture(), region.getRegion());
 }
 
+void xr::RenderBatch::setTexture(const TextureArray & textureArray, int layer, const Rectangle<float>& region)
+{
+	this->currentTextureArray = textureArray;
+	this->usingTextureArray = true;
+	this->currentArrayLayer = static_cast<GLuint>(layer);
+
+	this->setTextureRegion(region);
+}
+
 void xr::RenderBatch::clearTexture()
 {
 	this->setTexture(this->defaultTexture);
 }
 
-
-void xr::RenderBatch::fillRect(float x, float y, float w, float h)
+void xr::RenderBatch::setBlendMode(BlendMode mode)
 {
-    Mesh& currentMesh = getCurrentMesh();
-
-	// Get the index of the last vertex and start indexing from there
-	int startIndex = currentMesh.vertices.size();
-
-	// Add indices to all vertices
-	currentMesh.indices.emplace_back(0 + startIndex);
-	currentMesh.indices.emplace_back(1 + startIndex);
-	currentMesh.indices.emplace_back(2 + startIndex);
-	currentMesh.indices.emplace_back(2 + startIndex);
-	currentMesh.indices.emplace_back(3 + startIndex);
-	currentMesh.indices.emplace_back(0 + startIndex);
-
-    // Provide alias for 'currentTextureRegion'
-	auto& r = this->currentTextureRegion;
+	this->blendMode = mode;
+}
 
-	float z = 0;
+xr::BlendMode xr::RenderBatch::getBlendMode() const
+{
+	return this->blendMode;
+}
 
-	// Add vertices
-	currentMesh.vertices.emplace_back(glt::vec3f{ x, y, z }, glt::vec2f{ r.x, r.y + r.height }, this->fillColor);
-	currentMesh.vertices.emplace_back(glt::vec3f{ x, y + h, z }, glt::vec2f{ r.x, r.y }, this->fillColor);
-	currentMesh.vertices.emplace_back(glt::vec3f{ x + w, y + h, z }, glt::vec2f{ r.x + r.width, r.y }, this->fillColor);
-	currentMesh.vertices.emplace_back(glt::vec3f{ x + w, y, z }, glt::vec2f{ r.x + r.width, r.y + r.height }, this->fillColor);
+void xr::RenderBatch::setLayer(int layer)
+{
+	this->layer = layer;
 }
 
+void xr::RenderBatch::setSortMode(SortMode mode)
+{
+	this->sortMode = mode;
+}
 
+void xr::RenderBatch::setDepth(int depth)
+{
+	this->depth = depth;
+}
 
-/*
-////////////////////
-ALGORITHM:
-////////////////////
+void xr::RenderBatch::setPixelSize(float size)
+{
+	this->pixelSize = size;
 
-//// Determine inside
-1. Calculate the sum of all the corner's angles, counterclockwise and clockwise
-2. The side with the smaller angle sum is the inside
+	for (auto& subBatch : this->subBatches) {
+		subBatch->pixelSize = size;
+	}
+}
 
-//// Construct triangles
-3. Calculate the inner angle of the next corner
-4. If the angle is greater than 180 degrees, set that as the new centroid
-6. Otherwise construct triangle with the next 2 following points
-5. Repeat step 3-5 until all triangles are constructed
-*/
 
-void xr::RenderBatch::fillPolygon(const std::vector<glt::vec2f>& points)
+void xr::RenderBatch::fillRect(float x, float y, float w, float h)
 {
-    Mesh& currentMesh = getCurrentMesh();
-
-    int pointCount = points.size();
+	// Texture arrays are drawn through the sprite path, which carries the layer
+	if (this->usingTextureArray) {
+		this->drawSprite(x, y, w, h);
+		return;
+	}
 
-	if (pointCount < 3) {
+	// Smooth edges come from the shape shader, which can't sample textures
+	if (this->isSmoothing() && this->currentTexture == this->defaultTexture) {
+		this->addShape({ x + w / 2, y + h / 2 }, { fabsf(w) / 2, fabsf(h) / 2 }, 0, 0, 0);
 		return;
 	}
 
-#define IND(index) (((index) + pointCount) % pointCount)
+	if (!this->isVisible(x, y, w, h)) {
+		return;
+	}
 
-	auto getPoint = [&](int index) {
-		return points[IND(index)];
-	};
+    // Provide alias for 'regionTexCoords'
+	auto& t = this->regionTexCoords;
 
-	// List of all corner's angles
-	std::vector<float> angles(pointCount);
+	// Add vertices, the indices are shared by all quads
+	this->addQuad(
+		Vertex(glt::vec2f{ x, y }, t[0], this->fillColor),
+		Vertex(glt::vec2f{ x, y + h }, t[1], this->fillColor),
+		Vertex(glt::vec2f{ x + w, y + h }, t[2], this->fillColor),
+		Vertex(glt::vec2f{ x + w, y }, t[3], this->fillColor)
+	);
+}
 
 
-	// Determine inside
+void xr::RenderBatch::drawSprite(float x, float y, float w, float h, float rotation)
+{
+	if (rotation == 0) {
+		if (!this->isVisible(x, y, w, h)) {
+			return;
+		}
+	}
+	else {
+		// A rotated sprite stays within the circle through its corners
+		float radius = 0.5f * sqrtf(w * w + h * h);
+		float cx = x + 0.5f * w, cy = y + 0.5f * h;
+		if (!this->isVisible(cx - radius, cy - radius, 2 * radius, 2 * radius)) {
+			return;
+		}
+	}
 
-	// Calculate corner angles
-	for (int i = 0; i < pointCount; i++) {
-		glt::vec2f o = getPoint(i);
-		glt::vec2f a = glt::normalize(getPoint(i - 1) - o);
-		glt::vec2f b = glt::normalize(getPoint(i + 1) - o);
+	SpriteInstance sprite;
+	sprite.position = { x, y };
+	sprite.size = { w, h };
+	sprite.texCoordMin = this->regionTexCoords[1];
+	sprite.texCoordMax = this->regionTexCoords[3];
+	sprite.color = this->fillColor;
+	sprite.rotation = rotation;
+	sprite.layer = this->currentArrayLayer;
+
+	this->getCommand(this->usingTextureArray ? DRAW_ARRAY_SPRITES : DRAW_SPRITES);
+	this->sprites.push_back(sprite);
+}
 
-		float angle = angleBetween(a, b) + float(PI);
 
-		angles[i] = angle;
-	}
 
+void xr::RenderBatch::fillPolygon(const std::vector<glt::vec2f>& points)
+{
+	static const std::vector<std::vector<glt::vec2f>> noHoles;
+	this->fillPolygon(points, noHoles);
+}
 
-	// Sum all angles
-	float angleSum = 0;
-	for (int i = 0; i < pointCount; i++)
-	{
-		angleSum += angles[i];
+void xr::RenderBatch::fillPolygon(const std::vector<glt::vec2f>& outline, const std::vector<std::vector<glt::vec2f>>& holes)
+{
+	if (outline.size() < 3 || !this->isVisible(outline)) {
+		return;
 	}
 
-	// The total should be less than pointCount * PI if it's clockwise
-	bool clockwise = angleSum < pointCount * float(PI);
+	size_t pointCount = outline.size();
+	for (auto& hole : holes) {
+		pointCount += hole.size();
+	}
 
+	const std::vector<uint32_t>& triangles = this->triangulations.get(outline, holes);
+	if (triangles.empty()) {
+		return;
+	}
 
-	// Recalculate angles
-	if (!clockwise) {
-		for (int i = 0; i < pointCount; i++)
-		{
-			angles[i] = 2 * float(PI) - angles[i];
+	// Too many points to index with 16 bits, draw the triangles on their own
+	if (pointCount > MAX_INDEXED_VERTICES) {
+		std::vector<glt::vec2f> points(outline);
+		for (auto& hole : holes) {
+			points.insert(points.end(), hole.begin(), hole.end());
 		}
-	}
 
-	// Construct triangles
+		std::vector<glt::vec2f> corners;
+		corners.reserve(triangles.size());
+		for (uint32_t index : triangles) {
+			corners.push_back(points[index]);
+		}
 
-	// Add vertices
-	for (int i = 0; i < pointCount; i++)
-	{
-		currentMesh.vertices.emplace_back(glt::vec3f(getPoint(i), 0), glt::vec2f{ 0, 0 }, this->fillColor);
+		this->addTriangleList(corners);
+		return;
 	}
 
-	// Number of triangles left to construct
-	int trianglesLeft = pointCount - 2;
-	
-	// Current center point of triangle fan
-	int centroid = 0;
+	// The fringe doubles the vertices, leave it out if they don't fit
+	bool smoothing = this->isSmoothing() && 2 * pointCount <= MAX_INDEXED_VERTICES;
 
-	// Current point being added to triangle fan
-	int pointIndex = 1;
+	Mesh& currentMesh = getCurrentMesh(smoothing ? 2 * pointCount : pointCount);
 
-	// Add triangles until all are constructed
-	while (trianglesLeft) {
-		if (angles[pointIndex] > PI) {
-			// Switch centroid if angle is too large
-			centroid = pointIndex;
-		}
-		else {
-			// Add triangle
-			currentMesh.indices.emplace_back(centroid);
-			currentMesh.indices.emplace_back(pointIndex);
-			currentMesh.indices.emplace_back(IND(pointIndex + 1));
+	// Get the index of the first vertex, the triangles index from there
+	int startIndex = getStartIndex();
 
-			// Triangle is done
-			trianglesLeft--;
+	// Add vertices, holes follow the outline
+	for (auto& point : outline) {
+		currentMesh.vertices.emplace_back(point, PackedTexCoord(), this->fillColor);
+	}
+	for (auto& hole : holes) {
+		for (auto& point : hole) {
+			currentMesh.vertices.emplace_back(point, PackedTexCoord(), this->fillColor);
 		}
+	}
 
-		pointIndex = (pointIndex + 1) % pointCount;
+	for (uint32_t index : triangles) {
+		currentMesh.indices.push_back(static_cast<GLushort>(startIndex + index));
 	}
 
+	if (smoothing) {
+		int first = startIndex;
+		this->addFringe(first, static_cast<int>(outline.size()));
+		first += static_cast<int>(outline.size());
+
+		for (auto& hole : holes) {
+			if (hole.size() >= 3) {
+				this->addFringe(first, static_cast<int>(hole.size()), true);
+			}
+			first += static_cast<int>(hole.size());
+		}
+	}
 }
 
 void xr::RenderBatch::fillTriangleFan(const std::vector<glt::vec2f>& points)
 {
-    Mesh& currentMesh = getCurrentMesh();
-
+	if (!this->isVisible(points)) {
+		return;
+	}
 
     int pointCount = points.size();
 
+	// Too many points to index with 16 bits, draw the triangles on their own
+	if (size_t(pointCount) > MAX_INDEXED_VERTICES) {
+		std::vector<glt::vec2f> corners;
+		corners.reserve(3 * (pointCount - 2));
+		for (int i = 1; i < pointCount - 1; i++) {
+			corners.push_back(points[0]);
+			corners.push_back(points[i]);
+			corners.push_back(points[i + 1]);
+		}
+
+		this->addTriangleList(corners);
+		return;
+	}
+
+	// The fringe doubles the vertices, leave it out if they don't fit
+	bool smoothing = this->isSmoothing() && size_t(2 * pointCount) <= MAX_INDEXED_VERTICES;
+
+    Mesh& currentMesh = getCurrentMesh(smoothing ? 2 * pointCount : pointCount);
+
 
 	// Get the index of the last vertex and start indexing from there
-	int startIndex = currentMesh.vertices.size();
+	int startIndex = getStartIndex();
 
 
 	// Add vertices
 	for (int i = 0; i < pointCount; i++) {
-		currentMesh.vertices.emplace_back(glt::vec3f(points[i], 0), glt::vec2f{ 0, 0 }, this->fillColor);
+		currentMesh.vertices.emplace_back(points[i], PackedTexCoord(), this->fillColor);
 	}
 
 	// Add indices
@@ -207,23 +382,61 @@ void xr::RenderBatch::fillTriangleFan(const std::vector<glt::vec2f>& points)
 		currentMesh.indices.emplace_back(startIndex + i);
 		currentMesh.indices.emplace_back(startIndex + i + 1);
 	}
+
+	if (smoothing && pointCount >= 3) {
+		// A fan that comes back to its first point is outlined by its ring alone,
+		// the outline of an open one goes through the center too
+		const glt::vec2f& first = points[1];
+		const glt::vec2f& last = points.back();
+		if (pointCount >= 4 && first.x == last.x && first.y == last.y) {
+			this->addFringe(startIndex + 1, pointCount - 2);
+		}
+		else {
+			this->addFringe(startIndex, pointCount);
+		}
+	}
 }
 
 void xr::RenderBatch::fillCircle(float x, float y, float r, int segments)
 {
-    Mesh& currentMesh = getCurrentMesh();
+	if (!this->isVisible(x - r, y - r, 2 * r, 2 * r)) {
+		return;
+	}
+
+	// Too many segments to index with 16 bits, draw the triangles on their own
+	if (size_t(segments) + 1 > MAX_INDEXED_VERTICES) {
+		std::vector<glt::vec2f> corners;
+		corners.reserve(3 * segments);
+		for (int i = 0; i < segments; i++) {
+			for (int j : { i, i + 1 }) {
+				float angle = 2 * float(PI) * (j % segments) / float(segments);
+				if (j == i) {
+					corners.emplace_back(x, y);
+				}
+				corners.emplace_back(x + r * cosf(angle), y + r * sinf(angle));
+			}
+		}
+
+		this->addTriangleList(corners);
+		return;
+	}
+
+	// The fringe doubles the vertices, leave it out if they don't fit
+	bool smoothing = this->isSmoothing() && 2 * size_t(segments) + 1 <= MAX_INDEXED_VERTICES;
+
+    Mesh& currentMesh = getCurrentMesh(smoothing ? 2 * segments + 1 : segments + 1);
 
     // Get the index of the last vertex and start indexing from there
-	int startIndex = currentMesh.vertices.size();
+	int startIndex = getStartIndex();
 
 	// Add vertices
-	currentMesh.vertices.reserve(static_cast<unsigned int>(startIndex + segments + 1));
-	currentMesh.vertices.emplace_back(glt::vec3f(x, y, 0), glt::vec2f{ 0, 0 }, this->fillColor);
+	currentMesh.vertices.reserve(currentMesh.vertices.size() + segments + 1);
+	currentMesh.vertices.emplace_back(glt::vec2f(x, y), PackedTexCoord(), this->fillColor);
 	for (int i = 0; i < segments; i++)
 	{
 		float dx = r * cosf(2 * float(PI) * i / float(segments));
 		float dy = r * sinf(2 * float(PI) * i / float(segments));
-		currentMesh.vertices.emplace_back(glt::vec3f(x + dx, y + dy, 0), glt::vec2f{ 0, 0 }, this->fillColor);
+		currentMesh.vertices.emplace_back(glt::vec2f(x + dx, y + dy), PackedTexCoord(), this->fillColor);
 	}
 
 	currentMesh.indices.reserve(currentMesh.indices.size() + segments * 3);
@@ -232,13 +445,30 @@ void xr::RenderBatch::fillCircle(float x, float y, float r, int segments)
 		currentMesh.indices.emplace_back(startIndex + i + 1);
 		currentMesh.indices.emplace_back(startIndex + 1 + (i + 1) % segments);
 	}
+
+	if (smoothing) {
+		this->addFringe(startIndex + 1, segments);
+	}
 }
 
 
 
 void xr::RenderBatch::drawLine(float x0, float y0, float x1, float y1, float width)
 {
-    Mesh& currentMesh = getCurrentMesh();
+	// Smooth edges come from the shape shader, which can't sample textures
+	if (this->isSmoothing() && !this->usingTextureArray && this->currentTexture == this->defaultTexture) {
+		glt::vec2f delta = { x1 - x0, y1 - y0 };
+		glt::vec2f center = { x0 + delta.x / 2, y0 + delta.y / 2 };
+		this->addShape(center, { glt::length(delta) / 2, width / 2 }, atan2f(delta.y, delta.x), 0, 0);
+		return;
+	}
+
+	// The corners are at most half the width away from the end points
+	float margin = width / 2;
+	if (!this->isVisible(std::min(x0, x1) - margin, std::min(y0, y1) - margin,
+						 fabsf(x1 - x0) + width, fabsf(y1 - y0) + width)) {
+		return;
+	}
 
     // Find the direction of the line
 	glt::vec2f dir = glt::normalize(glt::vec2f{ x1 - x0, y1 - y0 });
@@ -252,47 +482,378 @@ void xr::RenderBatch::drawLine(float x0, float y0, float x1, float y1, float wid
 	glt::vec2f c = glt::vec2f{ x1, y1 } + perp * width / 2.f;
 	glt::vec2f d = glt::vec2f{ x1, y1 } - perp * width / 2.f;
 
-	
-	// Get the index of the last vertex and start indexing from there
-	int startIndex = currentMesh.vertices.size();
+	// Add vertices, going around the line
+	this->addQuad(
+		Vertex(a, PackedTexCoord(), this->fillColor),
+		Vertex(c, PackedTexCoord(), this->fillColor),
+		Vertex(d, PackedTexCoord(), this->fillColor),
+		Vertex(b, PackedTexCoord(), this->fillColor)
+	);
+}
 
-	// Add vertices
 
-	Vertex va {glt::vec3f{a}, glt::vec2f{0}, this->fillColor};
+void xr::RenderBatch::fillSmoothCircle(float x, float y, float r)
+{
+	this->addShape({ x, y }, { r, r }, 0, r, 0);
+}
+
+void xr::RenderBatch::drawRing(float x, float y, float r, float thickness)
+{
+	this->addShape({ x, y }, { r, r }, 0, r, thickness);
+}
+
+void xr::RenderBatch::fillRoundedRect(float x, float y, float w, float h, float radius)
+{
+	glt::vec2f halfSize = { fabsf(w) / 2, fabsf(h) / 2 };
+	this->addShape({ x + w / 2, y + h / 2 }, halfSize, 0, radius, 0);
+}
 
-	currentMesh.vertices.push_back(va);
-	currentMesh.vertices.emplace_back(glt::vec3f(b, 0), glt::vec2f(0), this->fillColor);
-	currentMesh.vertices.emplace_back(glt::vec3f(c, 0), glt::vec2f(0), this->fillColor);
-	currentMesh.vertices.emplace_back(glt::vec3f(d, 0), glt::vec2f(0), this->fillColor);
+void xr::RenderBatch::drawCapsule(float x0, float y0, float x1, float y1, float width)
+{
+	glt::vec2f delta = { x1 - x0, y1 - y0 };
+	float radius = width / 2;
 
-	currentMesh.indices.emplace_back(startIndex);
-	currentMesh.indices.emplace_back(startIndex + 1);
-	currentMesh.indices.emplace_back(startIndex + 2);
-	currentMesh.indices.emplace_back(startIndex + 2);
-	currentMesh.indices.emplace_back(startIndex + 3);
-	currentMesh.indices.emplace_back(startIndex + 1);
+	// A box along the line, reaching a radius past the end points
+	glt::vec2f center = { x0 + delta.x / 2, y0 + delta.y / 2 };
+	glt::vec2f halfSize = { glt::length(delta) / 2 + radius, radius };
+	this->addShape(center, halfSize, atan2f(delta.y, delta.x), radius, 0);
 }
 
 
 void xr::RenderBatch::fillTriangles(const std::vector<glt::vec2f>& points) 
 {
-    Mesh& currentMesh = getCurrentMesh();
+	if (!this->isVisible(points)) {
+		return;
+	}
 
-    // Get the index of the last vertex and start indexing from there
-	int startIndex = currentMesh.vertices.size();
+	this->addTriangleList(points);
+}
 
-	for (auto& point : points)
-	{
-		currentMesh.vertices.emplace_back(glt::vec3f(point, 0), glt::vec2f{ 0, 0 }, this->fillColor);
-		currentMesh.indices.emplace_back(startIndex);
-		startIndex++;
+void xr::RenderBatch::addTriangleList(const std::vector<glt::vec2f>& points)
+{
+	// Split into whole triangles that can be indexed with 16 bits
+	const size_t chunkSize = MAX_INDEXED_VERTICES / 3 * 3;
+
+	for (size_t chunk = 0; chunk < points.size(); chunk += chunkSize) {
+		size_t count = std::min(points.size() - chunk, chunkSize);
+
+		Mesh& currentMesh = getCurrentMesh(count);
+
+		// Get the index of the last vertex and start indexing from there
+		int startIndex = getStartIndex();
+
+		for (size_t i = chunk; i < chunk + count; i++)
+		{
+			currentMesh.vertices.emplace_back(points[i], PackedTexCoord(), this->fillColor);
+			currentMesh.indices.emplace_back(startIndex);
+			startIndex++;
+		}
 	}
 }
 
-xr::Mesh &xr::RenderBatch::getCurrentMesh() {
-    return currentTextureBatch->mesh;
+void xr::RenderBatch::compile(DrawList & list) const
+{
+	size_t batchCount = 1 + this->subBatches.size();
+
+	// Every batch is a source of its own, draws refer to its geometry directly
+	list.sources.clear();
+	for (size_t b = 0; b < batchCount; b++) {
+		const RenderBatch& batch = this->getBatch(b);
+		list.sources.push_back({ &batch.mesh.vertices, &batch.mesh.indices, &batch.sprites, &batch.shapes });
+	}
+
+	list.draws.clear();
+
+	// Sort the non-empty commands, equal keys keep the order they were recorded in
+	list.sortKeys.clear();
+	list.sortValues.clear();
+
+	uint64_t orderBase = 0;
+	for (size_t b = 0; b < batchCount; b++) {
+		const RenderBatch& batch = this->getBatch(b);
+
+		for (size_t i = 0; i < batch.commands.size(); i++) {
+			if (batch.getCommandCount(i) == 0) {
+				continue;
+			}
+
+			// Sub-batches are submitted after the batches before them
+			uint64_t key = batch.commands[i].key;
+			if (batch.commands[i].sequenced) {
+				key += orderBase << KEY_ORDER_SHIFT;
+			}
+
+			list.sortKeys.push_back(key);
+			list.sortValues.push_back(static_cast<uint32_t>(b << VALUE_BATCH_SHIFT | i));
+		}
+
+		orderBase += batch.commands.size();
+	}
+
+	// The order of the last command has to fit in its bits of the key
+	if (orderBase > MAX_SEQUENCED_COMMANDS) {
+		throw std::runtime_error("Too many draw commands in a single batch");
+	}
+
+	util::radixSort(list.sortKeys, list.sortValues, list.scratchKeys, list.scratchValues);
+
+	for (uint32_t value : list.sortValues) {
+		size_t b = value >> VALUE_BATCH_SHIFT;
+		size_t index = value & VALUE_COMMAND_MASK;
+		const RenderBatch& batch = this->getBatch(b);
+
+		DrawList::Draw draw = batch.commands[index].draw;
+		draw.count = batch.getCommandCount(index);
+		draw.source = static_cast<GLuint>(b);
+
+		// Extend the previous draw if this one continues it with the same state
+		// Only the indices of meshes are relative to the base vertex, other draws address their data directly
+		if (!list.draws.empty()) {
+			DrawList::Draw& last = list.draws.back();
+			if (last.type == draw.type && last.blend == draw.blend && last.source == draw.source &&
+				last.texture == draw.texture && last.textureArray == draw.textureArray &&
+				(draw.type != DRAW_MESH || last.baseVertex == draw.baseVertex) && last.first + last.count == draw.first) {
+				last.count += draw.count;
+				continue;
+			}
+		}
+
+		list.draws.push_back(draw);
+	}
 }
 
+bool xr::RenderBatch::isVisible(float x, float y, float w, float h)
+{
+	if (!this->culling) {
+		return true;
+	}
 
+	this->cullStats.tested++;
 
+	// Rectangles may extend in the negative direction
+	if (w < 0) {
+		x += w;
+		w = -w;
+	}
+	if (h < 0) {
+		y += h;
+		h = -h;
+	}
+
+	if (this->viewBounds.intersects(x, y, w, h)) {
+		return true;
+	}
+
+	this->cullStats.culled++;
+	return false;
+}
+
+bool xr::RenderBatch::isVisible(const std::vector<glt::vec2f>& points)
+{
+	if (!this->culling || points.empty()) {
+		return true;
+	}
+
+	// Test the bounding box of the points
+	glt::vec2f min = points[0], max = points[0];
+	for (auto& point : points) {
+		min.x = std::min(min.x, point.x);
+		min.y = std::min(min.y, point.y);
+		max.x = std::max(max.x, point.x);
+		max.y = std::max(max.y, point.y);
+	}
+
+	return this->isVisible(min.x, min.y, max.x - min.x, max.y - min.y);
+}
+
+xr::Mesh &xr::RenderBatch::getCurrentMesh(size_t vertexCount) {
+    getCommand(DRAW_MESH, vertexCount);
+    return mesh;
+}
 
+int xr::RenderBatch::getStartIndex() const
+{
+	return static_cast<int>(this->mesh.vertices.size() - this->commands.back().draw.baseVertex);
+}
+
+void xr::RenderBatch::addQuad(const Vertex & a, const Vertex & b, const Vertex & c, const Vertex & d)
+{
+	this->getCommand(DRAW_QUADS);
+
+	this->mesh.vertices.push_back(a);
+	this->mesh.vertices.push_back(b);
+	this->mesh.vertices.push_back(c);
+	this->mesh.vertices.push_back(d);
+}
+
+void xr::RenderBatch::addFringe(int first, int count, bool hole)
+{
+	GLuint base = this->commands.back().draw.baseVertex;
+	int outer = getStartIndex();
+
+	auto position = [&](int i) {
+		return this->mesh.vertices[base + first + (i + count) % count].position;
+	};
+
+	// Find the winding to know which side is the outside
+	float area = 0;
+	for (int i = 0; i < count; i++) {
+		glt::vec2f a = position(i), b = position(i + 1);
+		area += a.x * b.y - b.x * a.y;
+	}
+	// Holes are filled on their outside
+	float side = (area < 0) != hole ? -1.0f : 1.0f;
+
+	auto edgeNormal = [&](int i) {
+		glt::vec2f delta = position(i + 1) - position(i);
+		float length = glt::length(delta);
+		if (length == 0) {
+			return glt::vec2f(0.0f);
+		}
+		return glt::vec2f{ delta.y, -delta.x } * (side / length);
+	};
+
+	// Push each corner out by a pixel, along the average of its edges' normals
+	for (int i = 0; i < count; i++) {
+		glt::vec2f normal = (edgeNormal(i - 1) + edgeNormal(i)) * 0.5f;
+
+		// Lengthen the normal at sharp corners to keep the fringe a pixel wide, within a limit
+		float lengthSquared = glt::dot(normal, normal);
+		if (lengthSquared > 0.000001f) {
+			normal *= 1.0f / std::max(lengthSquared, 0.25f);
+		}
+
+		Vertex vertex = this->mesh.vertices[base + first + i];
+		vertex.position = vertex.position + normal * this->pixelSize;
+		vertex.color.a = 0;
+		this->mesh.vertices.push_back(vertex);
+	}
+
+	// Connect the outline to the pushed out corners
+	for (int i = 0; i < count; i++) {
+		int j = (i + 1) % count;
+		for (int index : { first + i, first + j, outer + j, outer + j, outer + i, first + i }) {
+			this->mesh.indices.push_back(static_cast<GLushort>(index));
+		}
+	}
+}
+
+void xr::RenderBatch::addShape(glt::vec2f center, glt::vec2f halfSize, float rotation, float radius, float thickness)
+{
+	// The box stays within the circle through its corners for any rotation
+	float extent = rotation == 0 ? 0 : glt::length(halfSize);
+	glt::vec2f bounds = rotation == 0 ? halfSize : glt::vec2f{ extent, extent };
+	if (!this->isVisible(center.x - bounds.x, center.y - bounds.y, 2 * bounds.x, 2 * bounds.y)) {
+		return;
+	}
+
+	ShapeInstance shape;
+	shape.center = center;
+	shape.halfSize = halfSize;
+	shape.rotation = rotation;
+	shape.radius = std::min(radius, std::min(halfSize.x, halfSize.y));
+	shape.thickness = thickness;
+	shape.color = this->fillColor;
+
+	this->getCommand(DRAW_SHAPES);
+	this->shapes.push_back(shape);
+}
+
+xr::RenderBatch::DrawCommand & xr::RenderBatch::getCommand(DrawType type, size_t vertexCount)
+{
+	DrawList::Draw draw;
+	draw.type = type;
+	draw.blend = this->blendMode;
+	draw.source = 0;
+	draw.first = static_cast<GLuint>(this->getEnd(type));
+	draw.count = 0;
+	draw.baseVertex = static_cast<GLuint>(this->mesh.vertices.size());
+
+	// Meshes and quads have nowhere to store the layer of a texture array
+	GLuint handle;
+	if (type == DRAW_ARRAY_SPRITES) {
+		draw.textureArray = this->currentTextureArray;
+		handle = draw.textureArray.getHandle();
+	}
+	else if (type == DRAW_SHAPES) {
+		// Shapes are never textured, don't let the texture split them up
+		draw.texture = this->defaultTexture;
+		handle = draw.texture.getHandle();
+	}
+	else {
+		draw.texture = type != DRAW_SPRITES && this->usingTextureArray ? this->defaultTexture : this->currentTexture;
+		handle = draw.texture.getHandle();
+	}
+
+	// Order by submission, or by depth to let equal state group up
+	bool sequenced = this->sortMode == SORT_SUBMISSION;
+	uint64_t order = sequenced ?
+		this->commands.size() :
+		static_cast<uint64_t>(this->depth + (1 << 23));
+
+	uint64_t key =
+		(static_cast<uint64_t>(this->layer + (1 << 15)) & 0xffff) << KEY_LAYER_SHIFT |
+		(order & 0xffffff) << KEY_ORDER_SHIFT |
+		static_cast<uint64_t>(type) << KEY_TYPE_SHIFT |
+		static_cast<uint64_t>(this->blendMode) << KEY_BLEND_SHIFT |
+		(handle & KEY_TEXTURE_MASK);
+
+	if (!this->commands.empty()) {
+		DrawCommand& last = this->commands.back();
+
+		// Consecutive submissions share their command
+		uint64_t mask = sequenced ? ~KEY_ORDER_MASK : ~0ull;
+
+		// Indices of a mesh have to reach all of its vertices
+		bool hasRoom = type != DRAW_MESH ||
+			this->mesh.vertices.size() + vertexCount - last.draw.baseVertex <= MAX_INDEXED_VERTICES;
+
+		if ((last.key & mask) == (key & mask) && last.sequenced == sequenced && last.draw.type == type &&
+			last.draw.texture == draw.texture && last.draw.textureArray == draw.textureArray && hasRoom) {
+			return last;
+		}
+
+		// The range of the previous command can't grow anymore
+		last.draw.count = this->getCommandCount(this->commands.size() - 1);
+	}
+
+	this->commands.push_back({ key, sequenced, draw });
+	return this->commands.back();
+}
+
+GLuint xr::RenderBatch::getCommandCount(size_t index) const
+{
+	const DrawList::Draw& draw = this->commands[index].draw;
+
+	// Only the last command is still growing
+	if (index + 1 < this->commands.size()) {
+		return draw.count;
+	}
+
+	return static_cast<GLuint>(this->getEnd(draw.type) - draw.first);
+}
+
+size_t xr::RenderBatch::getEnd(DrawType type) const
+{
+	switch (type) {
+	case DRAW_MESH: return this->mesh.indices.size();
+	case DRAW_QUADS: return this->mesh.vertices.size();
+	case DRAW_SHAPES: return this->shapes.size();
+	default: return this->sprites.size();
+	}
+}
+
+void xr::RenderBatch::setTextureRegion(const Rectangle<float>& region)
+{
+	// Pack the corners once instead of once per vertex
+	auto& r = region;
+	this->regionTexCoords[0] = PackedTexCoord(glt::vec2f{ r.x, r.y + r.height });
+	this->regionTexCoords[1] = PackedTexCoord(glt::vec2f{ r.x, r.y });
+	this->regionTexCoords[2] = PackedTexCoord(glt::vec2f{ r.x + r.width, r.y });
+	this->regionTexCoords[3] = PackedTexCoord(glt::vec2f{ r.x + r.width, r.y + r.height });
+}
+
+const xr::RenderBatch & xr::RenderBatch::getBatch(size_t index) const
+{
+	return index == 0 ? *this : *this->subBatches[index - 1];
+}
@@ -0,0 +1,205 @@
+#include "stdafx.h"
+#include "RenderStats.h"
+
+
+// Marks a submit without timestamps
+const size_t UNTIMED_SUBMIT = ~size_t(0);
+
+
+xr::RenderProfiler::RenderProfiler() :
+	currentFrame(0),
+	frameNumber(1),
+	lastTexture(0),
+	timing(false),
+	submitTimed(false)
+{
+}
+
+xr::RenderProfiler::~RenderProfiler()
+{
+	for (Frame& frame : this->frames) {
+		if (!frame.queries.empty()) {
+			glDeleteQueries(static_cast<GLsizei>(frame.queries.size()), frame.queries.data());
+		}
+	}
+}
+
+void xr::RenderProfiler::setTiming(bool enabled)
+{
+	this->timing = enabled;
+}
+
+void xr::RenderProfiler::beginSubmit(const char * label)
+{
+	Frame& frame = this->frames[this->currentFrame];
+	frame.stats.submits++;
+
+	SubmitStats submit;
+	if (label) {
+		submit.label = label;
+	}
+	frame.stats.submitStats.push_back(submit);
+
+	// A submit is timed as a whole, even if timing is switched on or off halfway
+	this->submitTimed = this->timing;
+	if (this->submitTimed) {
+		frame.submitQueries.push_back(frame.queryCount);
+		this->timestamp();
+	}
+	else {
+		frame.submitQueries.push_back(UNTIMED_SUBMIT);
+	}
+}
+
+void xr::RenderProfiler::endSubmit()
+{
+	if (this->submitTimed) {
+		this->timestamp();
+	}
+}
+
+void xr::RenderProfiler::beginTextureBatch(GLuint texture)
+{
+	Frame& frame = this->frames[this->currentFrame];
+
+	TextureBatchStats batch;
+	batch.texture = texture;
+	frame.stats.submitStats.back().textureBatches.push_back(batch);
+
+	if (texture != this->lastTexture) {
+		frame.stats.textureSwitches++;
+		this->lastTexture = texture;
+	}
+
+	if (this->submitTimed) {
+		this->timestamp();
+	}
+}
+
+void xr::RenderProfiler::countDraw(size_t indices, size_t instances)
+{
+	FrameStats& stats = this->frames[this->currentFrame].stats;
+	stats.drawCalls++;
+	stats.indices += indices;
+	stats.instances += instances;
+
+	SubmitStats& submit = stats.submitStats.back();
+	submit.drawCalls++;
+	if (!submit.textureBatches.empty()) {
+		submit.textureBatches.back().drawCalls++;
+	}
+}
+
+void xr::RenderProfiler::countMultiDraw(size_t indices, int commands)
+{
+	this->countDraw(indices, 0);
+	this->frames[this->currentFrame].stats.multiDrawCommands += commands;
+}
+
+void xr::RenderProfiler::countUpload(size_t vertices, size_t bytes)
+{
+	FrameStats& stats = this->frames[this->currentFrame].stats;
+	stats.vertices += vertices;
+	stats.bytesUploaded += bytes;
+}
+
+void xr::RenderProfiler::countShaderSwitch()
+{
+	this->frames[this->currentFrame].stats.shaderSwitches++;
+}
+
+void xr::RenderProfiler::endFrame()
+{
+	Frame& current = this->frames[this->currentFrame];
+	current.stats.frame = this->frameNumber;
+	current.pending = true;
+
+	// Read back whatever is ready, oldest first so that the latest stats never go back in time
+	for (int i = 1; i <= PROFILER_FRAME_COUNT; i++) {
+		Frame& frame = this->frames[(this->currentFrame + i) % PROFILER_FRAME_COUNT];
+		if (frame.pending && !this->resolve(frame, false)) {
+			break;
+		}
+	}
+
+	this->currentFrame = (this->currentFrame + 1) % PROFILER_FRAME_COUNT;
+	this->frameNumber++;
+
+	// The queries are about to be reused, this only waits if the GPU is several frames behind
+	Frame& next = this->frames[this->currentFrame];
+	if (next.pending) {
+		this->resolve(next, true);
+	}
+
+	next.stats = FrameStats();
+	next.queryCount = 0;
+	next.submitQueries.clear();
+}
+
+const xr::FrameStats & xr::RenderProfiler::getFrameStats() const
+{
+	return this->latest;
+}
+
+void xr::RenderProfiler::timestamp()
+{
+	Frame& frame = this->frames[this->currentFrame];
+
+	if (frame.queryCount == frame.queries.size()) {
+		GLuint query;
+		glGenQueries(1, &query);
+		frame.queries.push_back(query);
+	}
+
+	glQueryCounter(frame.queries[frame.queryCount++], GL_TIMESTAMP);
+}
+
+bool xr::RenderProfiler::resolve(Frame & frame, bool wait)
+{
+	if (frame.queryCount > 0) {
+		// Queries finish in order, so the last one being ready means all are
+		if (!wait) {
+			GLint available = 0;
+			glGetQueryObjectiv(frame.queries[frame.queryCount - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				return false;
+			}
+		}
+
+		std::vector<GLuint64> times(frame.queryCount);
+		for (size_t i = 0; i < frame.queryCount; i++) {
+			glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &times[i]);
+		}
+
+		auto milliseconds = [&](size_t start, size_t end) {
+			return (times[end] - times[start]) / 1000000.0;
+		};
+
+		// Each texture batch lasts until the next timestamp
+		FrameStats& stats = frame.stats;
+		stats.gpuTime = 0;
+		for (size_t i = 0; i < stats.submitStats.size(); i++) {
+			size_t first = frame.submitQueries[i];
+			if (first == UNTIMED_SUBMIT) {
+				continue;
+			}
+
+			SubmitStats& submit = stats.submitStats[i];
+			size_t batches = submit.textureBatches.size();
+			for (size_t j = 0; j < batches; j++) {
+				submit.textureBatches[j].gpuTime = milliseconds(first + 1 + j, first + 2 + j);
+			}
+
+			submit.gpuTime = milliseconds(first, first + 1 + batches);
+			stats.gpuTime += submit.gpuTime;
+		}
+	}
+
+	frame.pending = false;
+
+	if (frame.stats.frame > this->latest.frame) {
+		this->latest = frame.stats;
+	}
+
+	return true;
+}
@@ -0,0 +1,89 @@
+#include "stdafx.h"
+#include "RenderTarget.h"
+#include "GLState.h"
+
+
+xr::RenderTarget::RenderTarget(int width, int height) :
+	depthStencil(0),
+	width(width),
+	height(height)
+{
+	glGenFramebuffers(1, &this->framebuffer);
+	this->createAttachments();
+}
+
+xr::RenderTarget::~RenderTarget()
+{
+	this->releaseAttachments();
+
+	GLState::get().forgetFramebuffer(this->framebuffer);
+	glDeleteFramebuffers(1, &this->framebuffer);
+}
+
+void xr::RenderTarget::resize(int width, int height)
+{
+	if (width == this->width && height == this->height) {
+		return;
+	}
+
+	this->releaseAttachments();
+
+	this->width = width;
+	this->height = height;
+	this->createAttachments();
+}
+
+void xr::RenderTarget::bind()
+{
+	GLState::get().bindFramebuffer(this->framebuffer);
+}
+
+void xr::RenderTarget::bindDefault()
+{
+	GLState::get().bindFramebuffer(0);
+}
+
+const xr::Texture & xr::RenderTarget::getTexture() const
+{
+	return this->texture;
+}
+
+int xr::RenderTarget::getWidth() const
+{
+	return this->width;
+}
+
+int xr::RenderTarget::getHeight() const
+{
+	return this->height;
+}
+
+void xr::RenderTarget::createAttachments()
+{
+	// Filter linearly, the texture is rarely drawn exactly pixel for pixel
+	this->texture = Texture(this->width, this->height);
+	this->texture.setMinMagFilter(GL_LINEAR, GL_LINEAR);
+
+	// Stencil passes, like shadows, work the same as in the window
+	glGenRenderbuffers(1, &this->depthStencil);
+	glBindRenderbuffer(GL_RENDERBUFFER, this->depthStencil);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, this->width, this->height);
+
+	this->bind();
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture.getHandle(), 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, this->depthStencil);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		throw std::runtime_error("Failed to create render target!");
+	}
+}
+
+void xr::RenderTarget::releaseAttachments()
+{
+	GLuint handle = this->texture.getHandle();
+	GLState::get().forgetTexture(handle);
+	glDeleteTextures(1, &handle);
+
+	glDeleteRenderbuffers(1, &this->depthStencil);
+	this->depthStencil = 0;
+}
@@ -0,0 +1,311 @@
+#include "stdafx.h"
+#include "RenderThread.h"
+#include "GLBackend.h"
+#include "GLState.h"
+#include "JobSystem.h"
+#include "Trace.h"
+
+
+xr::FramePacket::FramePacket() :
+	listCount(0),
+	geometryCount(0),
+	windowSize(0, 0),
+	verticalSync(false)
+{
+}
+
+void xr::FramePacket::reset()
+{
+	this->commands.clear();
+	this->listCount = 0;
+	this->geometryCount = 0;
+}
+
+void xr::FramePacket::clear(glt::vec4f color)
+{
+	Command command = {};
+	command.type = COMMAND_CLEAR;
+	command.color = color;
+	this->commands.push_back(command);
+}
+
+void xr::FramePacket::submit(const DrawList & list, const glt::mat4f & transformation, glt::vec4f colorFilter, const char * label)
+{
+	XR_TRACE_SCOPE("FramePacket::submit");
+
+	if (this->listCount == this->lists.size()) {
+		this->lists.emplace_back();
+	}
+	DrawList& copy = this->lists[this->listCount];
+
+	// Copy the geometry into storage kept from earlier frames
+	copy.sources.clear();
+	for (const DrawList::Source& source : list.sources) {
+		if (this->geometryCount == this->geometry.size()) {
+			this->geometry.emplace_back();
+		}
+		Geometry& storage = this->geometry[this->geometryCount++];
+
+		storage.vertices.assign(source.vertices->begin(), source.vertices->end());
+		storage.indices.assign(source.indices->begin(), source.indices->end());
+		storage.sprites.assign(source.sprites->begin(), source.sprites->end());
+		storage.shapes.assign(source.shapes->begin(), source.shapes->end());
+
+		copy.sources.push_back({ &storage.vertices, &storage.indices, &storage.sprites, &storage.shapes });
+	}
+
+	copy.draws.assign(list.draws.begin(), list.draws.end());
+
+	Command command = {};
+	command.type = COMMAND_SUBMIT;
+	command.color = colorFilter;
+	command.transformation = transformation;
+	if (label) {
+		command.label = label;
+	}
+	command.list = this->listCount++;
+	this->commands.push_back(command);
+}
+
+void xr::FramePacket::submit(StaticBatch & batch, const glt::mat4f & transformation, glt::vec4f colorFilter, const char * label)
+{
+	Command command = {};
+	command.type = COMMAND_SUBMIT_STATIC;
+	command.color = colorFilter;
+	command.transformation = transformation;
+	if (label) {
+		command.label = label;
+	}
+	command.staticBatch = &batch;
+	this->commands.push_back(command);
+}
+
+void xr::FramePacket::setRenderTarget(RenderTarget * target)
+{
+	Command command = {};
+	command.type = COMMAND_SET_RENDER_TARGET;
+	command.target = target;
+	this->commands.push_back(command);
+}
+
+void xr::FramePacket::setGpuTiming(bool enabled)
+{
+	Command command = {};
+	command.type = COMMAND_SET_GPU_TIMING;
+	command.enabled = enabled;
+	this->commands.push_back(command);
+}
+
+void xr::FramePacket::setMultiDraw(bool enabled)
+{
+	Command command = {};
+	command.type = COMMAND_SET_MULTI_DRAW;
+	command.enabled = enabled;
+	this->commands.push_back(command);
+}
+
+void xr::FramePacket::replay(RenderBackend & backend) const
+{
+	for (const Command& command : this->commands) {
+		switch (command.type) {
+		case COMMAND_CLEAR:
+			backend.clear(command.color);
+			break;
+
+		case COMMAND_SUBMIT:
+			backend.submit(this->lists[command.list], command.transformation, command.color, command.label.c_str());
+			break;
+
+		case COMMAND_SUBMIT_STATIC:
+			backend.submit(*command.staticBatch, command.transformation, command.color, command.label.c_str());
+			break;
+
+		case COMMAND_SET_RENDER_TARGET:
+			backend.setRenderTarget(command.target);
+			break;
+
+		case COMMAND_SET_GPU_TIMING:
+			backend.setGpuTiming(command.enabled);
+			break;
+
+		case COMMAND_SET_MULTI_DRAW:
+			backend.setMultiDraw(command.enabled);
+			break;
+		}
+	}
+}
+
+
+
+xr::FrameRecorder::FrameRecorder(RenderThread & thread) :
+	thread(thread)
+{
+}
+
+void xr::FrameRecorder::clear(glt::vec4f color)
+{
+	this->thread.recordingFrame().clear(color);
+}
+
+void xr::FrameRecorder::submit(const DrawList & list, const glt::mat4f & transformation, glt::vec4f colorFilter, const char * label)
+{
+	this->thread.recordingFrame().submit(list, transformation, colorFilter, label);
+}
+
+void xr::FrameRecorder::submit(StaticBatch & batch, const glt::mat4f & transformation, glt::vec4f colorFilter, const char * label)
+{
+	this->thread.recordingFrame().submit(batch, transformation, colorFilter, label);
+}
+
+void xr::FrameRecorder::setRenderTarget(RenderTarget * target)
+{
+	this->thread.recordingFrame().setRenderTarget(target);
+}
+
+void xr::FrameRecorder::endFrame()
+{
+	this->thread.finishFrame();
+
+	std::lock_guard<std::mutex> lock(this->thread.mutex);
+	this->stats = this->thread.latestStats;
+}
+
+void xr::FrameRecorder::setGpuTiming(bool enabled)
+{
+	this->thread.recordingFrame().setGpuTiming(enabled);
+}
+
+void xr::FrameRecorder::setMultiDraw(bool enabled)
+{
+	this->thread.recordingFrame().setMultiDraw(enabled);
+}
+
+const xr::FrameStats & xr::FrameRecorder::getFrameStats() const
+{
+	return this->stats;
+}
+
+
+
+xr::RenderThread::RenderThread(Window & window, int frames) :
+	window(window),
+	frameCount(std::min(std::max(frames, 1), MAX_RENDER_THREAD_FRAMES)),
+	framesRecorded(0),
+	framesDrawn(0),
+	stopping(false),
+	renderer(new Renderer(std::unique_ptr<RenderBackend>(new FrameRecorder(*this))))
+{
+	// Make sure everything created so far reaches the GPU before the context moves
+	glFlush();
+	glfwMakeContextCurrent(nullptr);
+
+	this->thread = std::thread(&RenderThread::run, this);
+}
+
+xr::RenderThread::~RenderThread()
+{
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->frameRecorded.notify_one();
+
+	this->thread.join();
+
+	// The game may release GPU resources after this, the render thread changed the bindings
+	glfwMakeContextCurrent(this->window.getHandle());
+	GLState::get().invalidate();
+}
+
+xr::Renderer & xr::RenderThread::getRenderer()
+{
+	return *this->renderer;
+}
+
+xr::FramePacket & xr::RenderThread::recordingFrame()
+{
+	// The frame was made free when the previous one was finished
+	return this->frames[this->framesRecorded % this->frameCount];
+}
+
+void xr::RenderThread::finishFrame()
+{
+	XR_TRACE_SCOPE("RenderThread::finishFrame");
+
+	FramePacket& frame = this->recordingFrame();
+	frame.windowSize = this->window.getSize();
+	frame.verticalSync = this->window.getVerticalSync();
+
+	// Measure on the game thread, where update reads it
+	this->window.calculateLastFrameTime();
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->framesRecorded++;
+	this->frameRecorded.notify_one();
+
+	// Wait until the next frame in the ring has been drawn
+	this->frameDrawn.wait(lock, [this]() {
+		return this->framesRecorded - this->framesDrawn < uint64_t(this->frameCount);
+	});
+	lock.unlock();
+
+	this->recordingFrame().reset();
+}
+
+void xr::RenderThread::run()
+{
+	glfwMakeContextCurrent(this->window.getHandle());
+
+	{
+		GLBackend backend;
+		bool verticalSync = this->window.getVerticalSync();
+
+		while (true) {
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->frameRecorded.wait(lock, [this]() {
+				return this->framesDrawn < this->framesRecorded || this->stopping;
+			});
+
+			// Draw every frame that was recorded before stopping
+			if (this->framesDrawn == this->framesRecorded) {
+				break;
+			}
+
+			const FramePacket& frame = this->frames[this->framesDrawn % this->frameCount];
+			lock.unlock();
+
+			{
+				XR_TRACE_SCOPE("RenderThread::draw");
+
+				// This thread owns the context now
+				JobSystem::get().runContextJobs();
+
+				if (frame.verticalSync != verticalSync) {
+					verticalSync = frame.verticalSync;
+					glfwSwapInterval(verticalSync);
+				}
+
+				GLState::get().setViewport(0, 0, frame.windowSize.x, frame.windowSize.y);
+
+				frame.replay(backend);
+				backend.endFrame();
+			}
+
+			{
+				XR_TRACE_SCOPE("RenderThread::swapBuffers");
+
+				// The game thread measures the frame time, see finishFrame
+				this->window.swapBuffers(false);
+			}
+
+			lock.lock();
+			this->latestStats = backend.getFrameStats();
+			this->framesDrawn++;
+			lock.unlock();
+
+			this->frameDrawn.notify_one();
+		}
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
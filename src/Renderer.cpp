@@ -1,94 +1,94 @@
 #include "stdafx.h"
 
 #include "Renderer.h"
+#include "GLBackend.h"
+#include "Trace.h"
 
 
+xr::Renderer::Renderer() :
+	Renderer(std::unique_ptr<RenderBackend>(new GLBackend()))
+{
+}
 
-const char* vertexSource = R"(#version 330
-in vec3 position;
-in vec2 texCoord;
-in vec4 color;
+xr::Renderer::Renderer(std::unique_ptr<RenderBackend> backend) :
+	backend(std::move(backend)),
+	colorFilter(1, 1, 1, 1),
+	renderTarget(nullptr)
+{
+}
 
-uniform mat4 camera = mat4(1.0);
+void xr::Renderer::clear(float r, float g, float b, float a)
+{
+	this->backend->clear({ r, g, b, a });
+}
 
-out FragData {
-	vec3 position;
-	vec2 texCoord;
-	vec4 color;
-} frag;
+void xr::Renderer::submit(const RenderBatch & batch, const char* label)
+{
+	XR_TRACE_SCOPE("Renderer::submit");
 
-void main() {
-	gl_Position = camera * vec4(position, 1.0);
-	frag.position = position;
-	frag.texCoord = texCoord;
-	frag.color = color;
-})";
+	// Sort and merge the batch's commands
+	batch.compile(this->drawList);
 
-const char* fragmentSource = R"(#version 330
-in FragData {
-	vec3 position;
-	vec2 texCoord;
-	vec4 color;
-} frag;
+	if (this->drawList.draws.empty()) {
+		return;
+	}
 
-uniform sampler2D texture0;
-uniform vec4 colorFilter;
+	this->backend->submit(this->drawList, batch.transformation, this->colorFilter, label);
+}
 
-out vec4 outColor;
+void xr::Renderer::submit(StaticBatch & batch, const glt::mat4f & transformation, const char* label)
+{
+	XR_TRACE_SCOPE("Renderer::submit");
 
-void main() {
-	outColor = texture(texture0, frag.texCoord) * frag.color * colorFilter;
-})";
+	if (batch.empty()) {
+		return;
+	}
 
+	this->backend->submit(batch, transformation, this->colorFilter, label);
+}
 
-xr::Renderer::Renderer() :
-	shader(vertexSource, fragmentSource),
-	colorFilter(1, 1, 1, 1)
+void xr::Renderer::endFrame()
 {
-	shader.bindAttribute(ATTR_POSITION, "position");
-	shader.bindAttribute(ATTR_TEX_COORD, "texCoord");
-	shader.bindAttribute(ATTR_COLOR, "color");
-
-	this->uniformLocations.cameraMatrix = shader.getUniformLocation("camera");
-	this->uniformLocations.texture0 = shader.getUniformLocation("texture0");
-	this->uniformLocations.colorFilter = shader.getUniformLocation("colorFilter");
+	this->backend->endFrame();
 }
 
-void xr::Renderer::clear(float r, float g, float b, float a)
+void xr::Renderer::setGpuTiming(bool enabled)
 {
-	glClearColor(r, g, b, a);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	this->backend->setGpuTiming(enabled);
 }
 
-void xr::Renderer::submit(const RenderBatch & batch)
+void xr::Renderer::setMultiDraw(bool enabled)
 {
-	// Use shader
-	this->shader.use();
-
-	// Upload transformation
-	glUniformMatrix4fv(this->uniformLocations.cameraMatrix, 1, 0, batch.transformation.data);
+	this->backend->setMultiDraw(enabled);
+}
 
-	// Apply filters
-	glUniform4f(this->uniformLocations.colorFilter, colorFilter.r, colorFilter.g, colorFilter.b, colorFilter.a);
+const xr::FrameStats & xr::Renderer::getFrameStats() const
+{
+	return this->backend->getFrameStats();
+}
 
-	// Draw texture batches
-	for (auto& texturePair : batch.textureBatches) {
-		// Bind texture
-		texturePair.first.bind();
+void xr::Renderer::setColorFilter(glt::vec4f color)
+{
+	this->colorFilter = color;
+}
 
-		// Get texture data
-		const RenderBatch::TextureBatch& textureBatch = texturePair.second;
+glt::vec4f xr::Renderer::getColorFilter() const
+{
+	return this->colorFilter;
+}
 
-		// Upload mesh data
-		this->vertexBuffer.upload(textureBatch.mesh.vertices);
-		this->vertexBuffer.upload(textureBatch.mesh.indices);
+void xr::Renderer::setRenderTarget(RenderTarget * target)
+{
+	this->renderTarget = target;
+	this->backend->setRenderTarget(target);
+}
 
-		// Draw vertices
-		this->vertexBuffer.drawElements(textureBatch.mesh.indices.size(), 0);
-	}
+xr::RenderTarget * xr::Renderer::getRenderTarget() const
+{
+	return this->renderTarget;
 }
 
-void xr::Renderer::setColorFilter(glt::vec4f color)
+xr::RenderBackend & xr::Renderer::getBackend() const
 {
-	this->colorFilter = color;
+	return *this->backend;
 }
@@ -1,13 +1,14 @@
 #include "stdafx.h"
 #include "Shader.h"
+#include "GLState.h"
 
 
-xr::Shader::Shader(const char * vertexSource, const char * fragmentSource)
+xr::Shader::Shader(const char * vertexSource, const char * fragmentSource, const std::vector<AttributeBinding>& attributes)
 {
 	GLuint vertexShader = this->compileShaderSource(vertexSource, GL_VERTEX_SHADER);
 	GLuint fragmentShader = this->compileShaderSource(fragmentSource, GL_FRAGMENT_SHADER);
 
-	this->program = this->linkShaderProgram(vertexShader, fragmentShader);
+	this->program = this->linkShaderProgram(vertexShader, fragmentShader, attributes);
 
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
@@ -15,12 +16,13 @@ xr::Shader::Shader(const char * vertexSource, const char * fragmentSource)
 
 xr::Shader::~Shader()
 {
+	GLState::get().forgetProgram(this->program);
 	glDeleteProgram(this->program);
 }
 
 void xr::Shader::use()
 {
-	glUseProgram(this->program);
+	GLState::get().useProgram(this->program);
 }
 
 void xr::Shader::bindAttribute(GLuint location, const char * name)
@@ -28,6 +30,11 @@ void xr::Shader::bindAttribute(GLuint location, const char * name)
 	glBindAttribLocation(this->program, location, name);
 }
 
+void xr::Shader::link()
+{
+	linkProgram(this->program);
+}
+
 GLuint xr::Shader::getUniformLocation(const char * name)
 {
 	return glGetUniformLocation(this->program, name);
@@ -60,12 +67,24 @@ GLuint xr::Shader::compileShaderSource(const char * source, GLenum type)
 	return shader;
 }
 
-GLuint xr::Shader::linkShaderProgram(GLuint vertexShader, GLuint fragmentShader)
+GLuint xr::Shader::linkShaderProgram(GLuint vertexShader, GLuint fragmentShader, const std::vector<AttributeBinding>& attributes)
 {
 	GLuint program = glCreateProgram();
 	glAttachShader(program, vertexShader);
 	glAttachShader(program, fragmentShader);
 
+	// Bindings only take effect when the program is linked
+	for (const AttributeBinding& attribute : attributes) {
+		glBindAttribLocation(program, attribute.location, attribute.name);
+	}
+
+	linkProgram(program);
+
+	return program;
+}
+
+void xr::Shader::linkProgram(GLuint program)
+{
 	glLinkProgram(program);
 
 	// Check for link errors
@@ -84,6 +103,4 @@ GLuint xr::Shader::linkShaderProgram(GLuint vertexShader, GLuint fragmentShader)
 		// Abort
 		throw std::runtime_error(infoLog);
 	}
-
-	return program;
 }
@@ -0,0 +1,726 @@
+#include "stdafx.h"
+#include "SoftwareBackend.h"
+#include "StaticBatch.h"
+#include "JobSystem.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define XR_RASTER_SSE2
+#endif
+
+
+namespace {
+
+	// Width and height of a tile, in pixels
+	const int TILE_SIZE = 64;
+
+	// Submits with fewer triangles are rasterized on the calling thread alone
+	const size_t MIN_PARALLEL_TRIANGLES = 256;
+
+
+	// Signed distance to the edge of a shape, like the GL backend's shape shader
+	float shapeDistance(float px, float py, float halfWidth, float halfHeight, float radius, float thickness)
+	{
+		float qx = std::fabs(px) - halfWidth + radius;
+		float qy = std::fabs(py) - halfHeight + radius;
+		float ox = std::max(qx, 0.0f), oy = std::max(qy, 0.0f);
+		float distance = std::sqrt(ox * ox + oy * oy) + std::min(std::max(qx, qy), 0.0f) - radius;
+
+		// Keep a band along the inside of the edge
+		if (thickness > 0) {
+			distance = std::fabs(distance + 0.5f * thickness) - 0.5f * thickness;
+		}
+
+		return distance;
+	}
+
+
+	// Sample an image with nearest filtering and clamping at the edges, like textures are created
+	void sample(const xr::Image& image, float u, float v, float* color)
+	{
+		int width = image.getWidth(), height = image.getHeight();
+		if (width == 0 || height == 0) {
+			return;
+		}
+
+		int x = int(std::floor(std::min(std::max(u, 0.0f), 1.0f) * width));
+		int y = int(std::floor(std::min(std::max(v, 0.0f), 1.0f) * height));
+		x = std::min(x, width - 1);
+		y = std::min(y, height - 1);
+
+		const unsigned char* texel = image.data() + 4 * (x + y * width);
+		for (int i = 0; i < 4; i++) {
+			color[i] *= texel[i] / 255.0f;
+		}
+	}
+
+
+	float saturate(float value)
+	{
+		return value < 0 ? 0 : (value > 1 ? 1 : value);
+	}
+
+#ifdef XR_RASTER_SSE2
+	// Blend a color into a pixel with the blend functions the GL backend sets for each mode
+	// The window is set up with blending enabled and the equation left at GL_FUNC_ADD
+	__m128 blend(__m128 pixel, __m128 color, xr::BlendMode mode)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1);
+
+		// Selects the color channels, leaving alpha
+		const __m128 rgb = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+		color = _mm_min_ps(_mm_max_ps(color, zero), one);
+		__m128 alpha = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3));
+		__m128 inverseAlpha = _mm_sub_ps(one, alpha);
+
+		switch (mode) {
+		case xr::BLEND_ALPHA: {
+			__m128 factor = _mm_or_ps(_mm_and_ps(rgb, alpha), _mm_andnot_ps(rgb, one));
+			pixel = _mm_add_ps(_mm_mul_ps(color, factor), _mm_mul_ps(pixel, inverseAlpha));
+			break;
+		}
+
+		case xr::BLEND_ADDITIVE:
+			pixel = _mm_add_ps(pixel, _mm_and_ps(rgb, _mm_mul_ps(color, alpha)));
+			break;
+
+		case xr::BLEND_MULTIPLY:
+			pixel = _mm_mul_ps(pixel, _mm_or_ps(_mm_and_ps(rgb, color), _mm_andnot_ps(rgb, one)));
+			break;
+
+		case xr::BLEND_PREMULTIPLIED:
+			pixel = _mm_add_ps(color, _mm_mul_ps(pixel, inverseAlpha));
+			break;
+		}
+
+		// The window's colors are fixed point
+		return _mm_min_ps(_mm_max_ps(pixel, zero), one);
+	}
+#else
+	// Blend a color into a pixel with the blend functions the GL backend sets for each mode
+	// The window is set up with blending enabled and the equation left at GL_FUNC_ADD
+	void blend(float* pixel, const float* color, xr::BlendMode mode)
+	{
+		float r = saturate(color[0]), g = saturate(color[1]), b = saturate(color[2]), a = saturate(color[3]);
+
+		switch (mode) {
+		case xr::BLEND_ALPHA:
+			pixel[0] = r * a + pixel[0] * (1 - a);
+			pixel[1] = g * a + pixel[1] * (1 - a);
+			pixel[2] = b * a + pixel[2] * (1 - a);
+			pixel[3] = a + pixel[3] * (1 - a);
+			break;
+
+		case xr::BLEND_ADDITIVE:
+			pixel[0] += r * a;
+			pixel[1] += g * a;
+			pixel[2] += b * a;
+			break;
+
+		case xr::BLEND_MULTIPLY:
+			pixel[0] *= r;
+			pixel[1] *= g;
+			pixel[2] *= b;
+			break;
+
+		case xr::BLEND_PREMULTIPLIED:
+			pixel[0] = r + pixel[0] * (1 - a);
+			pixel[1] = g + pixel[1] * (1 - a);
+			pixel[2] = b + pixel[2] * (1 - a);
+			pixel[3] = a + pixel[3] * (1 - a);
+			break;
+		}
+
+		// The window's colors are fixed point
+		for (int i = 0; i < 4; i++) {
+			pixel[i] = saturate(pixel[i]);
+		}
+	}
+#endif
+
+}
+
+
+xr::SoftwareBackend::SoftwareBackend(int width, int height, int threads) :
+	width(0),
+	height(0),
+	threadCount(threads > 0 ? threads : JobSystem::get().getThreadCount() + 1),
+	nextTextureHandle(~0u - 1),
+	tileCount(0),
+	tilesX(0),
+	colorFilter(1, 1, 1, 1),
+	drawingToTarget(false)
+{
+	this->resize(width, height);
+}
+
+void xr::SoftwareBackend::resize(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	this->pixels.assign(size_t(width) * height * 4, 0.0f);
+
+	this->tilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	this->tileCount = this->tilesX * ((height + TILE_SIZE - 1) / TILE_SIZE);
+}
+
+int xr::SoftwareBackend::getWidth() const
+{
+	return this->width;
+}
+
+int xr::SoftwareBackend::getHeight() const
+{
+	return this->height;
+}
+
+xr::Image xr::SoftwareBackend::getImage() const
+{
+	std::vector<unsigned char> bytes(this->pixels.size());
+	for (size_t i = 0; i < bytes.size(); i++) {
+		bytes[i] = static_cast<unsigned char>(saturate(this->pixels[i]) * 255.0f + 0.5f);
+	}
+
+	return Image(bytes, this->width, this->height);
+}
+
+xr::Texture xr::SoftwareBackend::createTexture(const Image & image)
+{
+	Texture texture = Texture::fromHandle(this->nextTextureHandle--);
+	this->setTextureImage(texture, image);
+	return texture;
+}
+
+void xr::SoftwareBackend::setTextureImage(const Texture & texture, const Image & image)
+{
+	this->textures[texture.getHandle()] = image;
+}
+
+void xr::SoftwareBackend::setTextureImage(const TextureArray & textureArray, int layer, const Image & image)
+{
+	this->arrayLayers[{ textureArray.getHandle(), layer }] = image;
+}
+
+void xr::SoftwareBackend::clear(glt::vec4f color)
+{
+	if (this->drawingToTarget) {
+		return;
+	}
+
+	for (size_t i = 0; i < this->pixels.size(); i += 4) {
+		this->pixels[i + 0] = color.r;
+		this->pixels[i + 1] = color.g;
+		this->pixels[i + 2] = color.b;
+		this->pixels[i + 3] = color.a;
+	}
+}
+
+void xr::SoftwareBackend::submit(const DrawList & list, const glt::mat4f & transformation, glt::vec4f colorFilter, const char * label)
+{
+	this->profiler.beginSubmit(label);
+
+	for (const DrawList::Draw& draw : list.draws) {
+		switch (draw.type) {
+		case DRAW_MESH: this->profiler.countDraw(draw.count, 0); break;
+		case DRAW_QUADS: this->profiler.countDraw(draw.count / 4 * 6, 0); break;
+		default: this->profiler.countDraw(0, draw.count); break;
+		}
+	}
+
+	if (!this->drawingToTarget) {
+		this->colorFilter = colorFilter;
+		this->setup(list.draws, list.sources.data(), transformation);
+		this->rasterize();
+	}
+
+	this->profiler.endSubmit();
+}
+
+void xr::SoftwareBackend::submit(StaticBatch & /*batch*/, const glt::mat4f & /*transformation*/, glt::vec4f /*colorFilter*/, const char * label)
+{
+	this->profiler.beginSubmit(label);
+	this->profiler.endSubmit();
+}
+
+void xr::SoftwareBackend::setRenderTarget(RenderTarget * target)
+{
+	this->drawingToTarget = target != nullptr;
+}
+
+void xr::SoftwareBackend::endFrame()
+{
+	this->profiler.endFrame();
+}
+
+const xr::FrameStats & xr::SoftwareBackend::getFrameStats() const
+{
+	return this->profiler.getFrameStats();
+}
+
+xr::SoftwareBackend::Edge::Edge(float ax, float ay, float bx, float by)
+{
+	bool forward = ax < bx || (ax == bx && ay < by);
+	if (forward) {
+		this->x = ax; this->y = ay; this->dx = bx - ax; this->dy = by - ay;
+	}
+	else {
+		this->x = bx; this->y = by; this->dx = ax - bx; this->dy = ay - by;
+	}
+	this->sign = forward ? 1.0f : -1.0f;
+
+	// Of two triangles sharing the edge, exactly one has it as a top or left edge
+	float a = -this->sign * this->dy, b = this->sign * this->dx;
+	this->inclusive = a > 0 || (a == 0 && b > 0);
+}
+
+const xr::Image * xr::SoftwareBackend::findImage(const Texture & texture) const
+{
+	auto it = this->textures.find(texture.getHandle());
+	return it != this->textures.end() ? &it->second : nullptr;
+}
+
+const xr::Image * xr::SoftwareBackend::findImage(const TextureArray & textureArray, int layer) const
+{
+	auto it = this->arrayLayers.find({ textureArray.getHandle(), layer });
+	return it != this->arrayLayers.end() ? &it->second : nullptr;
+}
+
+void xr::SoftwareBackend::setup(const std::vector<DrawList::Draw>& draws, const DrawList::Source * sources, const glt::mat4f & transformation)
+{
+	this->vertices.clear();
+	this->triangles.clear();
+	this->materials.clear();
+	this->shapes.clear();
+
+	const float* m = transformation.data;
+	float w = float(this->width), h = float(this->height);
+
+	// Transform to pixels with the top row first
+	auto toPixels = [&](float x, float y, RasterVertex& vertex) {
+		float clipX = m[0] * x + m[4] * y + m[12];
+		float clipY = m[1] * x + m[5] * y + m[13];
+		float clipW = m[3] * x + m[7] * y + m[15];
+		vertex.x = (clipX / clipW + 1) * 0.5f * w;
+		vertex.y = (1 - clipY / clipW) * 0.5f * h;
+	};
+
+	auto setColor = [](const PackedColor& color, RasterVertex& vertex) {
+		vertex.r = color.r / 255.0f;
+		vertex.g = color.g / 255.0f;
+		vertex.b = color.b / 255.0f;
+		vertex.a = color.a / 255.0f;
+	};
+
+	// Shapes are padded by a pixel for their edges to fade out, like in the shape shader
+	float scaleX = std::sqrt(m[0] * m[0] + m[1] * m[1]) * w;
+	float scaleY = std::sqrt(m[4] * m[4] + m[5] * m[5]) * h;
+	float padding = std::max(scaleX > 0 ? 2 / scaleX : 0.0f, scaleY > 0 ? 2 / scaleY : 0.0f);
+
+	// Corners of sprites and shapes, in order around their edges
+	const float cornerX[4] = { 0, 1, 1, 0 };
+	const float cornerY[4] = { 0, 0, 1, 1 };
+
+	for (const DrawList::Draw& draw : draws) {
+		const DrawList::Source& source = sources[draw.source];
+
+		uint32_t material = uint32_t(this->materials.size());
+		if (draw.type != DRAW_ARRAY_SPRITES && draw.type != DRAW_SHAPES) {
+			this->materials.push_back({ this->findImage(draw.texture), draw.blend, -1 });
+		}
+
+		switch (draw.type) {
+		case DRAW_MESH:
+			for (GLuint i = 0; i + 2 < draw.count; i += 3) {
+				RasterTriangle triangle;
+				triangle.material = material;
+
+				for (int corner = 0; corner < 3; corner++) {
+					const Vertex& vertex = (*source.vertices)[(*source.indices)[draw.first + i + corner] + draw.baseVertex];
+
+					RasterVertex raster;
+					toPixels(vertex.position.x, vertex.position.y, raster);
+					raster.u = PackedTexCoord::unpack(vertex.texCoord.u);
+					raster.v = PackedTexCoord::unpack(vertex.texCoord.v);
+					setColor(vertex.color, raster);
+
+					triangle.vertices[corner] = uint32_t(this->vertices.size());
+					this->vertices.push_back(raster);
+				}
+
+				this->triangles.push_back(triangle);
+			}
+			break;
+
+		case DRAW_QUADS:
+			for (GLuint i = 0; i + 3 < draw.count; i += 4) {
+				RasterVertex corners[4];
+				for (int corner = 0; corner < 4; corner++) {
+					const Vertex& vertex = (*source.vertices)[draw.first + i + corner];
+					toPixels(vertex.position.x, vertex.position.y, corners[corner]);
+					corners[corner].u = PackedTexCoord::unpack(vertex.texCoord.u);
+					corners[corner].v = PackedTexCoord::unpack(vertex.texCoord.v);
+					setColor(vertex.color, corners[corner]);
+				}
+
+				this->addQuad(corners, material);
+			}
+			break;
+
+		case DRAW_SPRITES:
+		case DRAW_ARRAY_SPRITES: {
+			// Array sprites get a material per run of sprites sampling the same layer
+			GLuint currentLayer = ~0u;
+
+			for (GLuint i = 0; i < draw.count; i++) {
+				const SpriteInstance& sprite = (*source.sprites)[draw.first + i];
+
+				if (draw.type == DRAW_ARRAY_SPRITES && sprite.layer != currentLayer) {
+					currentLayer = sprite.layer;
+					material = uint32_t(this->materials.size());
+					this->materials.push_back({ this->findImage(draw.textureArray, int(sprite.layer)), draw.blend, -1 });
+				}
+
+				float c = std::cos(sprite.rotation), s = std::sin(sprite.rotation);
+				float centerX = sprite.position.x + 0.5f * sprite.size.x;
+				float centerY = sprite.position.y + 0.5f * sprite.size.y;
+
+				float minU = PackedTexCoord::unpack(sprite.texCoordMin.u), minV = PackedTexCoord::unpack(sprite.texCoordMin.v);
+				float maxU = PackedTexCoord::unpack(sprite.texCoordMax.u), maxV = PackedTexCoord::unpack(sprite.texCoordMax.v);
+
+				RasterVertex corners[4];
+				for (int corner = 0; corner < 4; corner++) {
+					float offsetX = (cornerX[corner] - 0.5f) * sprite.size.x;
+					float offsetY = (cornerY[corner] - 0.5f) * sprite.size.y;
+					toPixels(centerX + c * offsetX - s * offsetY, centerY + s * offsetX + c * offsetY, corners[corner]);
+
+					corners[corner].u = minU + (maxU - minU) * cornerX[corner];
+					corners[corner].v = minV + (maxV - minV) * (1 - cornerY[corner]);
+					setColor(sprite.color, corners[corner]);
+				}
+
+				this->addQuad(corners, material);
+			}
+			break;
+		}
+
+		case DRAW_SHAPES:
+			for (GLuint i = 0; i < draw.count; i++) {
+				const ShapeInstance& shape = (*source.shapes)[draw.first + i];
+
+				material = uint32_t(this->materials.size());
+				this->materials.push_back({ nullptr, draw.blend, int(this->shapes.size()) });
+				this->shapes.push_back({ shape.halfSize.x, shape.halfSize.y, shape.radius, shape.thickness });
+
+				float c = std::cos(shape.rotation), s = std::sin(shape.rotation);
+
+				RasterVertex corners[4];
+				for (int corner = 0; corner < 4; corner++) {
+					// Position relative to the center, before rotation
+					float x = (cornerX[corner] * 2 - 1) * (shape.halfSize.x + padding);
+					float y = (cornerY[corner] * 2 - 1) * (shape.halfSize.y + padding);
+					toPixels(shape.center.x + c * x - s * y, shape.center.y + s * x + c * y, corners[corner]);
+
+					corners[corner].u = x;
+					corners[corner].v = y;
+					setColor(shape.color, corners[corner]);
+				}
+
+				this->addQuad(corners, material);
+			}
+			break;
+		}
+	}
+}
+
+void xr::SoftwareBackend::addQuad(const RasterVertex corners[4], uint32_t material)
+{
+	uint32_t first = uint32_t(this->vertices.size());
+	this->vertices.insert(this->vertices.end(), corners, corners + 4);
+
+	this->triangles.push_back({ { first, first + 1, first + 2 }, material });
+	this->triangles.push_back({ { first + 2, first + 3, first }, material });
+}
+
+void xr::SoftwareBackend::rasterize()
+{
+	if (this->triangles.empty() || this->tileCount == 0) {
+		return;
+	}
+
+	int threads = this->triangles.size() < MIN_PARALLEL_TRIANGLES ? 1 : this->threadCount;
+
+	this->bins.resize(threads);
+	for (std::vector<std::vector<SetupTriangle>>& tiles : this->bins) {
+		tiles.resize(this->tileCount);
+		for (std::vector<SetupTriangle>& tile : tiles) {
+			tile.clear();
+		}
+	}
+
+	// Each part sets up a range of triangles and sorts them into its own bins
+	size_t triangleCount = this->triangles.size();
+	JobSystem::get().parallelFor(threads, [&](int thread) {
+		size_t first = triangleCount * thread / threads;
+		size_t last = triangleCount * (thread + 1) / threads;
+
+		std::vector<std::vector<SetupTriangle>>& tiles = this->bins[thread];
+
+		SetupTriangle setup;
+		for (size_t i = first; i < last; i++) {
+			if (!this->setupTriangle(this->triangles[i], setup)) {
+				continue;
+			}
+
+			for (int y = setup.minY / TILE_SIZE; y <= setup.maxY / TILE_SIZE; y++) {
+				for (int x = setup.minX / TILE_SIZE; x <= setup.maxX / TILE_SIZE; x++) {
+					tiles[y * this->tilesX + x].push_back(setup);
+				}
+			}
+		}
+	}, 1);
+
+	// Tiles cover separate pixels, so any thread can take any tile
+	if (threads == 1) {
+		for (int tile = 0; tile < this->tileCount; tile++) {
+			this->rasterizeTile(tile);
+		}
+		return;
+	}
+
+	JobSystem::get().parallelFor(this->tileCount, [&](int tile) {
+		this->rasterizeTile(tile);
+	}, 1);
+}
+
+bool xr::SoftwareBackend::setupTriangle(const RasterTriangle & triangle, SetupTriangle & setup) const
+{
+	const RasterVertex* v0 = &this->vertices[triangle.vertices[0]];
+	const RasterVertex* v1 = &this->vertices[triangle.vertices[1]];
+	const RasterVertex* v2 = &this->vertices[triangle.vertices[2]];
+
+	// Make the triangle run clockwise on screen, so that the inside is positive
+	// Also skips triangles with coordinates that are not a number
+	float area = (v1->x - v0->x) * (v2->y - v0->y) - (v1->y - v0->y) * (v2->x - v0->x);
+	if (!(area != 0)) {
+		return false;
+	}
+	if (area < 0) {
+		std::swap(v1, v2);
+		area = -area;
+	}
+
+	float left = std::min(v0->x, std::min(v1->x, v2->x)), right = std::max(v0->x, std::max(v1->x, v2->x));
+	float top = std::min(v0->y, std::min(v1->y, v2->y)), bottom = std::max(v0->y, std::max(v1->y, v2->y));
+	if (!(right >= 0 && left < this->width && bottom >= 0 && top < this->height)) {
+		return false;
+	}
+
+	setup.minX = int(std::max(left, 0.0f));
+	setup.minY = int(std::max(top, 0.0f));
+	setup.maxX = int(std::min(right, float(this->width - 1)));
+	setup.maxY = int(std::min(bottom, float(this->height - 1)));
+
+	// The edge opposite each vertex
+	setup.edges[0] = Edge(v1->x, v1->y, v2->x, v2->y);
+	setup.edges[1] = Edge(v2->x, v2->y, v0->x, v0->y);
+	setup.edges[2] = Edge(v0->x, v0->y, v1->x, v1->y);
+
+	// Each edge function is the weight of the opposite vertex times the area
+	// The weights change by these amounts per pixel
+	float inverseArea = 1 / area;
+	float weightX[3], weightY[3];
+	for (int i = 0; i < 3; i++) {
+		weightX[i] = -setup.edges[i].sign * setup.edges[i].dy * inverseArea;
+		weightY[i] = setup.edges[i].sign * setup.edges[i].dx * inverseArea;
+	}
+
+	auto plane = [&](float a0, float a1, float a2) {
+		Plane p;
+		p.dx = a0 * weightX[0] + a1 * weightX[1] + a2 * weightX[2];
+		p.dy = a0 * weightY[0] + a1 * weightY[1] + a2 * weightY[2];
+		p.base = a0 - p.dx * v0->x - p.dy * v0->y;
+		return p;
+	};
+
+	setup.u = plane(v0->u, v1->u, v2->u);
+	setup.v = plane(v0->v, v1->v, v2->v);
+
+	const float* c0 = &v0->r;
+	const float* c1 = &v1->r;
+	const float* c2 = &v2->r;
+	for (int i = 0; i < 4; i++) {
+		Plane channel = plane(c0[i], c1[i], c2[i]);
+		setup.colorBase[i] = channel.base;
+		setup.colorDx[i] = channel.dx;
+		setup.colorDy[i] = channel.dy;
+	}
+
+	setup.material = triangle.material;
+	return true;
+}
+
+void xr::SoftwareBackend::rasterizeTile(int tile)
+{
+	int minX = (tile % this->tilesX) * TILE_SIZE;
+	int minY = (tile / this->tilesX) * TILE_SIZE;
+	int maxX = std::min(minX + TILE_SIZE, this->width) - 1;
+	int maxY = std::min(minY + TILE_SIZE, this->height) - 1;
+
+	for (const std::vector<std::vector<SetupTriangle>>& tiles : this->bins) {
+		for (const SetupTriangle& triangle : tiles[tile]) {
+			this->rasterizeTriangle(triangle, minX, minY, maxX, maxY);
+		}
+	}
+}
+
+void xr::SoftwareBackend::rasterizeTriangle(const SetupTriangle & triangle, int minX, int minY, int maxX, int maxY)
+{
+	const Edge* edges = triangle.edges;
+	const Plane& u = triangle.u;
+	const Plane& v = triangle.v;
+
+	const Material& material = this->materials[triangle.material];
+	const Shape* shape = material.shape >= 0 ? &this->shapes[material.shape] : nullptr;
+
+	// Multiply a color by the texture or by a shape's coverage, return false if nothing is left to draw
+	auto modulate = [&](float px, float py, float* color) {
+		if (shape) {
+			// Fade out over one pixel across the edge, measuring the pixel like fwidth does
+			float su = u.at(px, py), sv = v.at(px, py);
+			float distance = shapeDistance(su, sv, shape->halfWidth, shape->halfHeight, shape->radius, shape->thickness);
+			float nextX = shapeDistance(su + u.dx, sv + v.dx, shape->halfWidth, shape->halfHeight, shape->radius, shape->thickness);
+			float nextY = shapeDistance(su + u.dy, sv + v.dy, shape->halfWidth, shape->halfHeight, shape->radius, shape->thickness);
+			float width = std::fabs(nextX - distance) + std::fabs(nextY - distance);
+
+			color[3] *= saturate(0.5f - distance / std::max(width, 1e-5f));
+			return color[3] > 0 || material.blend == BLEND_MULTIPLY;
+		}
+
+		if (material.texture) {
+			sample(*material.texture, u.at(px, py), v.at(px, py), color);
+		}
+
+		return true;
+	};
+
+	int startX = std::max(minX, triangle.minX), endX = std::min(maxX, triangle.maxX);
+	int startY = std::max(minY, triangle.minY), endY = std::min(maxY, triangle.maxY);
+
+#ifdef XR_RASTER_SSE2
+	// The color of all four channels at once
+	const __m128 colorBase = _mm_loadu_ps(triangle.colorBase);
+	const __m128 colorDx = _mm_loadu_ps(triangle.colorDx);
+	const __m128 colorDy = _mm_loadu_ps(triangle.colorDy);
+	const __m128 filter = _mm_set_ps(this->colorFilter.a, this->colorFilter.b, this->colorFilter.g, this->colorFilter.r);
+	bool modulated = shape || material.texture;
+
+	// Color a pixel whose center is inside
+	auto shade = [&](int x, int y) {
+		float px = x + 0.5f, py = y + 0.5f;
+		__m128 color = _mm_add_ps(colorBase, _mm_add_ps(_mm_mul_ps(colorDx, _mm_set1_ps(px)), _mm_mul_ps(colorDy, _mm_set1_ps(py))));
+
+		if (modulated) {
+			alignas(16) float channels[4];
+			_mm_store_ps(channels, color);
+			if (!modulate(px, py, channels)) {
+				return;
+			}
+			color = _mm_load_ps(channels);
+		}
+
+		float* pixel = &this->pixels[4 * (size_t(y) * this->width + x)];
+		_mm_storeu_ps(pixel, blend(_mm_loadu_ps(pixel), _mm_mul_ps(color, filter), material.blend));
+	};
+
+	// Test four pixels at once, evaluating the edges exactly like Edge::inside does
+	const __m128 laneOffsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	__m128 edgeX[3], edgeDy[3], edgeSign[3];
+	for (int i = 0; i < 3; i++) {
+		edgeX[i] = _mm_set1_ps(edges[i].x);
+		edgeDy[i] = _mm_set1_ps(edges[i].dy);
+		edgeSign[i] = _mm_set1_ps(edges[i].sign);
+	}
+
+	for (int y = startY; y <= endY; y++) {
+		float py = y + 0.5f;
+
+		// The part of the edge function that is the same along the row
+		__m128 rowTerm[3];
+		for (int i = 0; i < 3; i++) {
+			rowTerm[i] = _mm_set1_ps(edges[i].dx * (py - edges[i].y));
+		}
+
+		for (int x = startX; x <= endX; x += 4) {
+			__m128 px = _mm_add_ps(_mm_set1_ps(float(x)), laneOffsets);
+
+			__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int i = 0; i < 3; i++) {
+				__m128 e = _mm_mul_ps(edgeSign[i], _mm_sub_ps(rowTerm[i], _mm_mul_ps(edgeDy[i], _mm_sub_ps(px, edgeX[i]))));
+				inside = _mm_and_ps(inside, edges[i].inclusive ? _mm_cmpge_ps(e, zero) : _mm_cmpgt_ps(e, zero));
+			}
+
+			int mask = _mm_movemask_ps(inside);
+			if (endX - x < 3) {
+				mask &= (1 << (endX - x + 1)) - 1;
+			}
+
+			// Runs of plain colored pixels step the color along instead of evaluating it for each pixel
+			if (mask == 0xF && !modulated) {
+				float* pixel = &this->pixels[4 * (size_t(y) * this->width + x)];
+				__m128 color = _mm_mul_ps(filter, _mm_add_ps(colorBase, _mm_add_ps(
+					_mm_mul_ps(colorDx, _mm_set1_ps(x + 0.5f)), _mm_mul_ps(colorDy, _mm_set1_ps(py)))));
+				__m128 step = _mm_mul_ps(filter, colorDx);
+
+				for (int lane = 0; lane < 4; lane++, pixel += 4) {
+					_mm_storeu_ps(pixel, blend(_mm_loadu_ps(pixel), color, material.blend));
+					color = _mm_add_ps(color, step);
+				}
+				continue;
+			}
+
+			for (int lane = 0; mask; lane++, mask >>= 1) {
+				if (mask & 1) {
+					shade(x + lane, y);
+				}
+			}
+		}
+	}
+#else
+	// Color a pixel whose center is inside
+	auto shade = [&](int x, int y) {
+		float px = x + 0.5f, py = y + 0.5f;
+
+		float color[4];
+		for (int i = 0; i < 4; i++) {
+			color[i] = triangle.colorBase[i] + triangle.colorDx[i] * px + triangle.colorDy[i] * py;
+		}
+
+		if (!modulate(px, py, color)) {
+			return;
+		}
+
+		color[0] *= this->colorFilter.r;
+		color[1] *= this->colorFilter.g;
+		color[2] *= this->colorFilter.b;
+		color[3] *= this->colorFilter.a;
+
+		blend(&this->pixels[4 * (size_t(y) * this->width + x)], color, material.blend);
+	};
+
+	for (int y = startY; y <= endY; y++) {
+		float py = y + 0.5f;
+		for (int x = startX; x <= endX; x++) {
+			float px = x + 0.5f;
+			if (edges[0].inside(px, py) && edges[1].inside(px, py) && edges[2].inside(px, py)) {
+				shade(x, y);
+			}
+		}
+	}
+#endif
+}
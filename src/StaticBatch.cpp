@@ -0,0 +1,75 @@
+#include "stdafx.h"
+#include "StaticBatch.h"
+
+xr::StaticBatch::StaticBatch() :
+	spriteBuffer(sizeof(SpriteInstance), getSpriteInstanceAttributes()),
+	shapeBuffer(sizeof(ShapeInstance), getShapeInstanceAttributes())
+{
+}
+
+void xr::StaticBatch::upload(const RenderBatch & batch)
+{
+	DrawList list;
+	batch.compile(list);
+
+	std::vector<Vertex> vertices;
+	std::vector<GLushort> indices;
+	std::vector<SpriteInstance> sprites;
+	std::vector<ShapeInstance> shapes;
+
+	// Join the sources so that all draws read from the same buffers
+	// Indices are relative to their draw's base vertex and can be copied as they are
+	std::vector<GLuint> vertexOffsets, indexOffsets, spriteOffsets, shapeOffsets;
+	for (const DrawList::Source& source : list.sources) {
+		vertexOffsets.push_back(static_cast<GLuint>(vertices.size()));
+		indexOffsets.push_back(static_cast<GLuint>(indices.size()));
+		spriteOffsets.push_back(static_cast<GLuint>(sprites.size()));
+		shapeOffsets.push_back(static_cast<GLuint>(shapes.size()));
+
+		vertices.insert(vertices.end(), source.vertices->begin(), source.vertices->end());
+		indices.insert(indices.end(), source.indices->begin(), source.indices->end());
+		sprites.insert(sprites.end(), source.sprites->begin(), source.sprites->end());
+		shapes.insert(shapes.end(), source.shapes->begin(), source.shapes->end());
+	}
+
+	this->draws = list.draws;
+	for (DrawList::Draw& draw : this->draws) {
+		switch (draw.type) {
+		case DRAW_MESH:
+			draw.first += indexOffsets[draw.source];
+			draw.baseVertex += vertexOffsets[draw.source];
+			break;
+		case DRAW_QUADS:
+			draw.first += vertexOffsets[draw.source];
+			break;
+		case DRAW_SHAPES:
+			draw.first += shapeOffsets[draw.source];
+			break;
+		default:
+			draw.first += spriteOffsets[draw.source];
+			break;
+		}
+		draw.source = 0;
+	}
+
+	// The geometry is never written to again
+	this->vertexBuffer.upload(vertices, GL_STATIC_DRAW);
+	this->vertexBuffer.upload(indices, GL_STATIC_DRAW);
+	this->spriteBuffer.upload(sprites.data(), static_cast<GLsizei>(sprites.size()), GL_STATIC_DRAW);
+	this->shapeBuffer.upload(shapes.data(), static_cast<GLsizei>(shapes.size()), GL_STATIC_DRAW);
+}
+
+void xr::StaticBatch::clear()
+{
+	this->draws.clear();
+}
+
+bool xr::StaticBatch::empty() const
+{
+	return this->draws.empty();
+}
+
+const std::vector<xr::DrawList::Draw>& xr::StaticBatch::getDraws() const
+{
+	return this->draws;
+}
@@ -1,6 +1,7 @@
 #include "stdafx.h"
 
 #include "Texture.h"
+#include "GLState.h"
 
 xr::Texture::Texture(int width, int height, GLenum format, const unsigned char * data)
 {
@@ -13,7 +14,6 @@ xr::Texture::Texture(int width, int height, GLenum format, const unsigned char *
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	
 	this->setMinMagFilter(GL_NEAREST, GL_NEAREST);
-	Texture::unbind();
 }
 
 xr::Texture::Texture(const Image & image)
@@ -26,14 +26,21 @@ xr::Texture::Texture()
 {
 }
 
+xr::Texture xr::Texture::fromHandle(GLuint handle)
+{
+	Texture texture;
+	texture.texture = handle;
+	return texture;
+}
+
 void xr::Texture::bind() const
 {
-	glBindTexture(GL_TEXTURE_2D, this->texture);
+	GLState::get().bindTexture(GL_TEXTURE_2D, this->texture);
 }
 
 void xr::Texture::unbind()
 {
-	glBindTexture(GL_TEXTURE_2D, 0);
+	GLState::get().bindTexture(GL_TEXTURE_2D, 0);
 }
 
 void xr::Texture::setMinMagFilter(GLenum min, GLenum mag)
@@ -41,7 +48,11 @@ void xr::Texture::setMinMagFilter(GLenum min, GLenum mag)
 	this->bind();
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag);
-	Texture::unbind();
+}
+
+GLuint xr::Texture::getHandle() const
+{
+	return this->texture;
 }
 
 bool xr::Texture::operator<(const Texture & other) const
@@ -85,3 +96,95 @@ xr::Texture xr::TextureRegion::getTexture() const
 	return this->texture;
 }
 
+
+
+xr::TextureArray::TextureArray(int width, int height, int layers) :
+	width(width),
+	height(height),
+	layers(layers)
+{
+	glGenTextures(1, &this->texture);
+
+	this->bind();
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	this->setMinMagFilter(GL_NEAREST, GL_NEAREST);
+}
+
+xr::TextureArray::TextureArray(const std::vector<Image>& images) :
+	TextureArray(images.empty() ? 0 : images.front().getWidth(),
+				 images.empty() ? 0 : images.front().getHeight(),
+				 static_cast<int>(images.size()))
+{
+	for (int i = 0; i < this->layers; i++) {
+		this->setLayer(i, images[i]);
+	}
+}
+
+xr::TextureArray::TextureArray() :
+	texture(-1),
+	width(0),
+	height(0),
+	layers(0)
+{
+}
+
+void xr::TextureArray::setLayer(int layer, const Image & image)
+{
+	if (image.getWidth() != this->width || image.getHeight() != this->height) {
+		throw std::runtime_error("Image size does not match the texture array's layer size!");
+	}
+
+	this->bind();
+	glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+}
+
+void xr::TextureArray::bind() const
+{
+	GLState::get().bindTexture(GL_TEXTURE_2D_ARRAY, this->texture);
+}
+
+void xr::TextureArray::setMinMagFilter(GLenum min, GLenum mag)
+{
+	this->bind();
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, min);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, mag);
+}
+
+int xr::TextureArray::getWidth() const
+{
+	return this->width;
+}
+
+int xr::TextureArray::getHeight() const
+{
+	return this->height;
+}
+
+int xr::TextureArray::getLayerCount() const
+{
+	return this->layers;
+}
+
+GLuint xr::TextureArray::getHandle() const
+{
+	return this->texture;
+}
+
+bool xr::TextureArray::operator<(const TextureArray & other) const
+{
+	return this->texture < other.texture;
+}
+
+bool xr::TextureArray::operator==(const TextureArray & other) const
+{
+	return this->texture == other.texture;
+}
+
+bool xr::TextureArray::operator!=(const TextureArray & other) const
+{
+	return !(*this == other);
+}
@@ -0,0 +1,180 @@
+#include "stdafx.h"
+#include "Trace.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace {
+
+	// Most zones a thread can record before new ones are dropped
+	const size_t TRACE_BUFFER_CAPACITY = 1 << 16;
+
+
+	// A finished zone
+	struct TraceEvent {
+		const char* name;
+		uint64_t start, end;
+	};
+
+
+	// Zones recorded by one thread, only that thread writes to it
+	struct ThreadBuffer {
+		// Number of the thread in the trace
+		size_t threadId;
+
+		// Storage for the zones, never reallocated so that it can be read while written
+		std::unique_ptr<TraceEvent[]> events;
+
+		// Number of zones written, published after each zone
+		std::atomic<size_t> count;
+
+		// Number of zones that didn't fit
+		std::atomic<size_t> dropped;
+	};
+
+
+	// Are zones being recorded
+	std::atomic<bool> recording(false);
+
+	// The buffers of all threads that have recorded, kept after their threads exit
+	std::mutex buffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+	// When the tracer was first used
+	const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+
+	// Return the calling thread's buffer, creating it on first use
+	ThreadBuffer& getThreadBuffer()
+	{
+		thread_local ThreadBuffer* buffer = nullptr;
+
+		if (!buffer) {
+			std::unique_ptr<ThreadBuffer> created(new ThreadBuffer());
+			created->events.reset(new TraceEvent[TRACE_BUFFER_CAPACITY]);
+			created->count = 0;
+			created->dropped = 0;
+
+			std::lock_guard<std::mutex> lock(buffersMutex);
+			created->threadId = buffers.size() + 1;
+			buffer = created.get();
+			buffers.push_back(std::move(created));
+		}
+
+		return *buffer;
+	}
+
+	// Write a string as a JSON string
+	void writeString(std::ostream& out, const char* text)
+	{
+		out << '"';
+		for (const char* c = text; *c; c++) {
+			if (*c == '"' || *c == '\\') {
+				out << '\\';
+			}
+			out << *c;
+		}
+		out << '"';
+	}
+}
+
+
+void xr::Tracer::start()
+{
+	recording.store(true, std::memory_order_relaxed);
+}
+
+void xr::Tracer::stop()
+{
+	recording.store(false, std::memory_order_relaxed);
+}
+
+bool xr::Tracer::isRecording()
+{
+	return recording.load(std::memory_order_relaxed);
+}
+
+void xr::Tracer::exportChromeTrace(const std::string & path)
+{
+	std::ofstream file(path);
+	if (!file) {
+		throw std::runtime_error("Failed to open trace file: " + path);
+	}
+
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	// Microseconds with nanosecond precision
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+	bool first = true;
+	for (auto& buffer : buffers) {
+		// Zones written after this are simply left out
+		size_t count = buffer->count.load(std::memory_order_acquire);
+
+		for (size_t i = 0; i < count; i++) {
+			const TraceEvent& event = buffer->events[i];
+
+			file << (first ? "\n" : ",\n") << "{\"name\":";
+			writeString(file, event.name);
+
+			// Complete events, in microseconds
+			file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->threadId
+				<< ",\"ts\":" << event.start / 1000.0
+				<< ",\"dur\":" << (event.end - event.start) / 1000.0 << "}";
+
+			first = false;
+		}
+	}
+
+	file << "\n]}\n";
+}
+
+void xr::Tracer::clear()
+{
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	for (auto& buffer : buffers) {
+		buffer->count.store(0, std::memory_order_relaxed);
+		buffer->dropped.store(0, std::memory_order_relaxed);
+	}
+}
+
+void xr::Tracer::record(const char * name, uint64_t start, uint64_t end)
+{
+	ThreadBuffer& buffer = getThreadBuffer();
+
+	size_t index = buffer.count.load(std::memory_order_relaxed);
+	if (index >= TRACE_BUFFER_CAPACITY) {
+		buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	buffer.events[index] = { name, start, end };
+
+	// Let exporting threads see the zone
+	buffer.count.store(index + 1, std::memory_order_release);
+}
+
+size_t xr::Tracer::getDroppedCount()
+{
+	std::lock_guard<std::mutex> lock(buffersMutex);
+
+	size_t dropped = 0;
+	for (auto& buffer : buffers) {
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	}
+	return dropped;
+}
+
+uint64_t xr::Tracer::now()
+{
+	auto elapsed = std::chrono::steady_clock::now() - epoch;
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
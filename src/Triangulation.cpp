@@ -0,0 +1,566 @@
+#include "stdafx.h"
+#include "Triangulation.h"
+
+#include <cmath>
+
+
+namespace {
+
+	// A corner of the polygon being clipped
+	struct Node {
+		// Index of the point
+		uint32_t index;
+
+		// Neighbouring nodes
+		int prev, next;
+
+		// Has the corner been clipped
+		bool removed;
+	};
+
+
+	// Twice the signed area of a triangle, positive if counter-clockwise (with y up)
+	float cross(glt::vec2f a, glt::vec2f b, glt::vec2f c)
+	{
+		return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+	}
+
+	// Twice the signed area of a polygon, positive if counter-clockwise (with y up)
+	float signedArea(const std::vector<glt::vec2f>& points)
+	{
+		float area = 0;
+		for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+			area += points[j].x * points[i].y - points[i].x * points[j].y;
+		}
+		return area;
+	}
+
+	// Is 'p' inside or on the edge of the counter-clockwise triangle (a, b, c)
+	bool pointInTriangle(glt::vec2f a, glt::vec2f b, glt::vec2f c, glt::vec2f p)
+	{
+		return cross(a, b, p) >= 0 && cross(b, c, p) >= 0 && cross(c, a, p) >= 0;
+	}
+
+	bool equal(glt::vec2f a, glt::vec2f b)
+	{
+		return a.x == b.x && a.y == b.y;
+	}
+
+
+	// Clips ears off a polygon stored as a linked list of nodes
+	class EarClipper {
+
+		// All points, outline first
+		const std::vector<glt::vec2f>& points;
+
+		// The nodes of the polygon
+		std::vector<Node> nodes;
+
+
+		// Uniform grid over the concave corners, used to find corners inside ears
+		glt::vec2f gridMin;
+		glt::vec2f cellSize;
+		int gridWidth, gridHeight;
+
+		// Corners in each cell, cell 'i' holds cellNodes[cellStart[i] .. cellEnd[i]]
+		std::vector<int> cellStart;
+		std::vector<int> cellEnd;
+		std::vector<int> cellNodes;
+
+	public:
+
+		EarClipper(const std::vector<glt::vec2f>& points)
+			: points(points), gridWidth(0), gridHeight(0) {}
+
+
+		// Add a ring of points as a linked list, in the given winding, and return its first node
+		int addRing(uint32_t first, uint32_t count, bool counterClockwise)
+		{
+			std::vector<glt::vec2f> ring(this->points.begin() + first, this->points.begin() + first + count);
+			bool reverse = (signedArea(ring) > 0) != counterClockwise;
+
+			int start = static_cast<int>(this->nodes.size());
+			for (uint32_t i = 0; i < count; i++) {
+				uint32_t index = first + (reverse ? count - 1 - i : i);
+				int node = static_cast<int>(this->nodes.size());
+				this->nodes.push_back({ index, node - 1, node + 1, false });
+			}
+
+			this->nodes[start].prev = start + count - 1;
+			this->nodes.back().next = start;
+
+			return start;
+		}
+
+
+		// Connect a hole to the outline through a pair of bridge edges
+		void bridgeHole(int outline, int hole)
+		{
+			// Start at the hole's leftmost point
+			int m = hole;
+			for (int node = this->nodes[hole].next; node != hole; node = this->nodes[node].next) {
+				if (this->point(node).x < this->point(m).x) {
+					m = node;
+				}
+			}
+
+			int bridge = this->findBridge(outline, m);
+			if (bridge < 0) {
+				return;
+			}
+
+			this->split(bridge, m);
+		}
+
+
+		// Clip all ears, writing their triangles
+		void clip(int start, std::vector<uint32_t>& indices)
+		{
+			this->buildGrid();
+
+			// Be less strict each time no ear is found
+			int pass = 0;
+			int ear = start;
+			int stop = ear;
+
+			while (this->nodes[ear].prev != this->nodes[ear].next) {
+				int prev = this->nodes[ear].prev;
+				int next = this->nodes[ear].next;
+
+				if (this->isEar(ear, pass)) {
+					indices.push_back(this->nodes[prev].index);
+					indices.push_back(this->nodes[ear].index);
+					indices.push_back(this->nodes[next].index);
+
+					this->remove(ear);
+
+					// Skipping the next corner gives fewer sliver triangles
+					ear = this->nodes[next].next;
+					stop = ear;
+					pass = 0;
+					continue;
+				}
+
+				ear = next;
+
+				if (ear == stop) {
+					if (pass == 0) {
+						ear = this->filterPoints(ear);
+					}
+					if (++pass > 2) {
+						break;
+					}
+					stop = ear;
+				}
+			}
+		}
+
+	private:
+
+		glt::vec2f point(int node) const
+		{
+			return this->points[this->nodes[node].index];
+		}
+
+
+		// Is the corner at 'ear' a triangle containing no other corner
+		// Pass 1 ignores other corners, pass 2 also accepts concave corners
+		bool isEar(int ear, int pass)
+		{
+			const Node& node = this->nodes[ear];
+			glt::vec2f a = this->point(node.prev), b = this->point(ear), c = this->point(node.next);
+
+			if (pass >= 2) {
+				return true;
+			}
+
+			// Concave corners are never ears
+			if (cross(a, b, c) <= 0) {
+				return false;
+			}
+
+			if (pass == 1) {
+				return true;
+			}
+
+			float minX = std::min(a.x, std::min(b.x, c.x)), maxX = std::max(a.x, std::max(b.x, c.x));
+			float minY = std::min(a.y, std::min(b.y, c.y)), maxY = std::max(a.y, std::max(b.y, c.y));
+
+			int x0, y0, x1, y1;
+			this->cellOf({ minX, minY }, x0, y0);
+			this->cellOf({ maxX, maxY }, x1, y1);
+
+			for (int y = y0; y <= y1; y++) {
+				for (int x = x0; x <= x1; x++) {
+					int cell = x + y * this->gridWidth;
+					for (int i = this->cellStart[cell]; i < this->cellEnd[cell]; i++) {
+						int other = this->cellNodes[i];
+						const Node& otherNode = this->nodes[other];
+						glt::vec2f p = this->point(other);
+
+						// Only concave corners can reach into an ear, drop the others from the grid for good
+						if (otherNode.removed || cross(this->point(otherNode.prev), p, this->point(otherNode.next)) > 0) {
+							this->cellNodes[i--] = this->cellNodes[--this->cellEnd[cell]];
+							continue;
+						}
+
+						if (other == ear || other == node.prev || other == node.next) {
+							continue;
+						}
+
+						// Copies made for bridges touch the ear without being inside it
+						if (equal(p, a) || equal(p, b) || equal(p, c)) {
+							continue;
+						}
+
+						if (pointInTriangle(a, b, c, p)) {
+							return false;
+						}
+					}
+				}
+			}
+
+			return true;
+		}
+
+
+		// Unlink a node from its neighbours
+		void remove(int node)
+		{
+			Node& removed = this->nodes[node];
+			this->nodes[removed.prev].next = removed.next;
+			this->nodes[removed.next].prev = removed.prev;
+			removed.removed = true;
+		}
+
+
+		// Remove duplicate and collinear corners, return a node that remains
+		int filterPoints(int start)
+		{
+			int node = start;
+			bool again;
+			do {
+				again = false;
+
+				const Node& current = this->nodes[node];
+				if (current.prev == current.next) {
+					break;
+				}
+
+				glt::vec2f a = this->point(current.prev), b = this->point(node), c = this->point(current.next);
+				if (equal(a, b) || cross(a, b, c) == 0) {
+					int prev = current.prev;
+					this->remove(node);
+					node = start = prev;
+					again = true;
+				}
+				else {
+					node = current.next;
+				}
+			} while (again || node != start);
+
+			return node;
+		}
+
+
+		// Find a corner of the outline that can be connected to the hole's corner 'm'
+		int findBridge(int outline, int m) const
+		{
+			glt::vec2f h = this->point(m);
+
+			// Cast a ray to the left and find the closest edge it hits
+			int candidate = -1;
+			float hitX = -INFINITY;
+
+			int node = outline;
+			do {
+				int next = this->nodes[node].next;
+				glt::vec2f p = this->point(node), q = this->point(next);
+
+				if (h.y <= std::max(p.y, q.y) && h.y >= std::min(p.y, q.y) && p.y != q.y) {
+					float x = p.x + (h.y - p.y) * (q.x - p.x) / (q.y - p.y);
+					if (x <= h.x && x > hitX) {
+						hitX = x;
+
+						if (x == h.x) {
+							return h.y == p.y ? node : next;
+						}
+
+						// The end of the edge furthest to the left
+						candidate = p.x < q.x ? node : next;
+					}
+				}
+
+				node = next;
+			} while (node != outline);
+
+			if (candidate < 0) {
+				return -1;
+			}
+
+			// Corners inside the triangle between the hole, the hit and the candidate block the bridge,
+			// pick the one closest to the ray instead
+			glt::vec2f hit = { hitX, h.y };
+			glt::vec2f c = this->point(candidate);
+
+			int bridge = candidate;
+			float minTan = INFINITY;
+
+			node = candidate;
+			do {
+				glt::vec2f p = this->point(node);
+
+				bool inside = h.y < c.y ?
+					pointInTriangle(h, hit, c, p) || pointInTriangle(h, c, hit, p) :
+					pointInTriangle(hit, h, c, p) || pointInTriangle(c, h, hit, p);
+
+				if (h.x >= p.x && p.x >= c.x && h.x != p.x && inside) {
+					float tan = fabsf(h.y - p.y) / (h.x - p.x);
+					if (tan < minTan || (tan == minTan && p.x > this->point(bridge).x)) {
+						bridge = node;
+						minTan = tan;
+					}
+				}
+
+				node = this->nodes[node].next;
+			} while (node != candidate);
+
+			return bridge;
+		}
+
+
+		// Connect node 'a' to node 'b' with a pair of edges, duplicating both
+		void split(int a, int b)
+		{
+			int a2 = static_cast<int>(this->nodes.size());
+			int b2 = a2 + 1;
+			this->nodes.push_back(this->nodes[a]);
+			this->nodes.push_back(this->nodes[b]);
+
+			int an = this->nodes[a].next;
+			int bp = this->nodes[b].prev;
+
+			this->nodes[a].next = b;
+			this->nodes[b].prev = a;
+
+			this->nodes[a2].next = an;
+			this->nodes[an].prev = a2;
+
+			this->nodes[b2].next = a2;
+			this->nodes[a2].prev = b2;
+
+			this->nodes[bp].next = b2;
+			this->nodes[b2].prev = bp;
+		}
+
+
+		// Sort the concave corners into a grid of roughly one corner per cell
+		// Clipping ears only makes corners more convex, so no other corner has to be added later
+		void buildGrid()
+		{
+			std::vector<int> concave;
+			for (size_t i = 0; i < this->nodes.size(); i++) {
+				const Node& node = this->nodes[i];
+				if (!node.removed && cross(this->point(node.prev), this->point(static_cast<int>(i)), this->point(node.next)) <= 0) {
+					concave.push_back(static_cast<int>(i));
+				}
+			}
+
+			glt::vec2f min = this->point(0), max = min;
+			for (size_t i = 0; i < this->nodes.size(); i++) {
+				glt::vec2f p = this->point(static_cast<int>(i));
+				min.x = std::min(min.x, p.x);
+				min.y = std::min(min.y, p.y);
+				max.x = std::max(max.x, p.x);
+				max.y = std::max(max.y, p.y);
+			}
+
+			int side = std::max(1, static_cast<int>(std::sqrt(static_cast<float>(concave.size()))));
+			this->gridWidth = side;
+			this->gridHeight = side;
+			this->gridMin = min;
+			this->cellSize = { std::max((max.x - min.x) / side, 1e-6f), std::max((max.y - min.y) / side, 1e-6f) };
+
+			// Count the corners in each cell, then place them
+			int cellCount = this->gridWidth * this->gridHeight;
+			this->cellStart.assign(cellCount + 1, 0);
+
+			std::vector<int> cells(concave.size());
+			for (size_t i = 0; i < concave.size(); i++) {
+				int x, y;
+				this->cellOf(this->point(concave[i]), x, y);
+				cells[i] = x + y * this->gridWidth;
+				this->cellStart[cells[i] + 1]++;
+			}
+
+			for (int i = 0; i < cellCount; i++) {
+				this->cellStart[i + 1] += this->cellStart[i];
+			}
+
+			this->cellNodes.resize(concave.size());
+			this->cellEnd.assign(this->cellStart.begin(), this->cellStart.end() - 1);
+			for (size_t i = 0; i < concave.size(); i++) {
+				this->cellNodes[this->cellEnd[cells[i]]++] = concave[i];
+			}
+		}
+
+		// Find the cell containing a point, clamped to the grid
+		void cellOf(glt::vec2f p, int& x, int& y) const
+		{
+			x = static_cast<int>((p.x - this->gridMin.x) / this->cellSize.x);
+			y = static_cast<int>((p.y - this->gridMin.y) / this->cellSize.y);
+			x = std::max(0, std::min(x, this->gridWidth - 1));
+			y = std::max(0, std::min(y, this->gridHeight - 1));
+		}
+	};
+
+
+	// Hash the bytes of the points, FNV-1a
+	uint64_t hashPolygon(const std::vector<glt::vec2f>& outline, const std::vector<std::vector<glt::vec2f>>& holes)
+	{
+		uint64_t hash = 14695981039346656037ull;
+
+		auto hashBytes = [&](const void* data, size_t length) {
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			for (size_t i = 0; i < length; i++) {
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+		};
+
+		hashBytes(outline.data(), outline.size() * sizeof(glt::vec2f));
+		for (auto& hole : holes) {
+			size_t size = hole.size();
+			hashBytes(&size, sizeof(size));
+			hashBytes(hole.data(), hole.size() * sizeof(glt::vec2f));
+		}
+
+		return hash;
+	}
+}
+
+
+void xr::triangulate(const std::vector<glt::vec2f>& outline,
+					 const std::vector<std::vector<glt::vec2f>>& holes,
+					 std::vector<uint32_t>& indices)
+{
+	indices.clear();
+
+	if (outline.size() < 3) {
+		return;
+	}
+
+	// Put all points in one list, outline first
+	std::vector<glt::vec2f> points = outline;
+	for (auto& hole : holes) {
+		points.insert(points.end(), hole.begin(), hole.end());
+	}
+
+	EarClipper clipper(points);
+	int start = clipper.addRing(0, static_cast<uint32_t>(outline.size()), true);
+
+	// Holes wind the other way, so that bridging them keeps the polygon consistent
+	std::vector<std::pair<float, int>> holeStarts;
+	uint32_t first = static_cast<uint32_t>(outline.size());
+	for (auto& hole : holes) {
+		if (hole.size() >= 3) {
+			int holeStart = clipper.addRing(first, static_cast<uint32_t>(hole.size()), false);
+
+			float left = hole[0].x;
+			for (auto& point : hole) {
+				left = std::min(left, point.x);
+			}
+			holeStarts.emplace_back(left, holeStart);
+		}
+		first += static_cast<uint32_t>(hole.size());
+	}
+
+	// Bridge holes from left to right, so that earlier bridges don't block later ones
+	std::sort(holeStarts.begin(), holeStarts.end());
+	for (auto& hole : holeStarts) {
+		clipper.bridgeHole(start, hole.second);
+	}
+
+	clipper.clip(start, indices);
+}
+
+
+
+xr::TriangulationCache::TriangulationCache(size_t capacity) :
+	useCounter(0),
+	capacity(capacity)
+{
+}
+
+const std::vector<uint32_t>& xr::TriangulationCache::get(const std::vector<glt::vec2f>& outline,
+														 const std::vector<std::vector<glt::vec2f>>& holes)
+{
+	uint64_t hash = hashPolygon(outline, holes);
+
+	auto it = this->entries.find(hash);
+	if (it != this->entries.end() && matches(it->second, outline, holes)) {
+		it->second.lastUse = ++this->useCounter;
+		return it->second.indices;
+	}
+
+	// Make room for the new polygon
+	if (it == this->entries.end() && this->entries.size() >= this->capacity && !this->entries.empty()) {
+		auto oldest = this->entries.begin();
+		for (auto entry = this->entries.begin(); entry != this->entries.end(); ++entry) {
+			if (entry->second.lastUse < oldest->second.lastUse) {
+				oldest = entry;
+			}
+		}
+		this->entries.erase(oldest);
+	}
+
+	// A different polygon with the same hash is replaced
+	Entry& entry = this->entries[hash];
+	entry.points = outline;
+	entry.holeSizes.clear();
+	for (auto& hole : holes) {
+		entry.points.insert(entry.points.end(), hole.begin(), hole.end());
+		entry.holeSizes.push_back(hole.size());
+	}
+	entry.lastUse = ++this->useCounter;
+
+	triangulate(outline, holes, entry.indices);
+
+	return entry.indices;
+}
+
+void xr::TriangulationCache::clear()
+{
+	this->entries.clear();
+}
+
+bool xr::TriangulationCache::matches(const Entry & entry,
+									 const std::vector<glt::vec2f>& outline,
+									 const std::vector<std::vector<glt::vec2f>>& holes)
+{
+	if (entry.holeSizes.size() != holes.size()) {
+		return false;
+	}
+
+	size_t offset = outline.size();
+	size_t total = outline.size();
+	for (size_t i = 0; i < holes.size(); i++) {
+		if (entry.holeSizes[i] != holes[i].size()) {
+			return false;
+		}
+		total += holes[i].size();
+	}
+
+	if (entry.points.size() != total ||
+		!std::equal(outline.begin(), outline.end(), entry.points.begin(), equal)) {
+		return false;
+	}
+
+	for (auto& hole : holes) {
+		if (!std::equal(hole.begin(), hole.end(), entry.points.begin() + offset, equal)) {
+			return false;
+		}
+		offset += hole.size();
+	}
+
+	return true;
+}
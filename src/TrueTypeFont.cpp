@@ -5,6 +5,7 @@
 #include <vector>
 #include <BitmapFont.h>
 #include "TrueTypeFont.h"
+#include "Trace.h"
 
 ft::FT_Library xr::TrueTypeFont::library;
 
@@ -60,6 +61,7 @@ void xr::TrueTypeFont::setFaceSize(ft::FT_Face &face, int size) {
 
 void
 xr::TrueTypeFont::generateBitmapFont(ft::FT_Face &face, const std::vector<char> &characterCodes, bool flipVertically) {
+    XR_TRACE_SCOPE("TrueTypeFont::generateBitmapFont");
 
     std::vector<Character> characters;
     std::vector<Image> images;
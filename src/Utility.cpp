@@ -24,3 +24,47 @@ std::vector<unsigned char> xr::util::loadBytes(const char * path)
 
 	return buffer;
 }
+
+void xr::util::radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+						 std::vector<uint64_t>& scratchKeys, std::vector<uint32_t>& scratchValues)
+{
+	size_t count = keys.size();
+
+	// Each pass scatters into the scratch space and swaps, so both keep their capacity
+	std::vector<uint64_t>& sortedKeys = scratchKeys;
+	std::vector<uint32_t>& sortedValues = scratchValues;
+	sortedKeys.resize(count);
+	sortedValues.resize(count);
+
+	for (int shift = 0; shift < 64; shift += 8) {
+		// Count the occurrences of each byte
+		size_t offsets[256] = {};
+		for (size_t i = 0; i < count; i++) {
+			offsets[(keys[i] >> shift) & 0xff]++;
+		}
+
+		// Nothing to do if every key has the same byte
+		if (count == 0 || offsets[(keys[0] >> shift) & 0xff] == count) {
+			continue;
+		}
+
+		// Find where each byte starts
+		size_t total = 0;
+		for (size_t& offset : offsets) {
+			size_t occurrences = offset;
+			offset = total;
+			total += occurrences;
+		}
+
+		// Scatter in order, keeping equal keys in their current order
+		for (size_t i = 0; i < count; i++) {
+			size_t& offset = offsets[(keys[i] >> shift) & 0xff];
+			sortedKeys[offset] = keys[i];
+			sortedValues[offset] = values[i];
+			offset++;
+		}
+
+		keys.swap(sortedKeys);
+		values.swap(sortedValues);
+	}
+}
@@ -2,8 +2,11 @@
 #include <chrono>
 
 #include "Window.h"
+#include "GLState.h"
 
-xr::Window::Window(int width, int height, const char * title, const WindowPreferences& preferences)
+xr::Window::Window(int width, int height, const char * title, const WindowPreferences& preferences) :
+	lastFrameTime(0),
+	frameMeasured(false)
 {
 	this->initGLFW();
 	this->create(width, height, title, preferences);
@@ -31,22 +34,29 @@ void xr::Window::pollEvents()
 	glfwPollEvents();
 }
 
-void xr::Window::swapBuffers()
+void xr::Window::swapBuffers(bool measureFrameTime)
 {
 	glfwSwapBuffers(this->glfwHandle);
 
-	this->calculateLastFrameTime();
+	if (measureFrameTime) {
+		this->calculateLastFrameTime();
+	}
 }
 
 void xr::Window::calculateLastFrameTime()
 {
 	using namespace std::chrono;
-	static time_point<high_resolution_clock > last = high_resolution_clock::now();
 	time_point<high_resolution_clock > now = high_resolution_clock::now();
 
-    auto dur = duration_cast<nanoseconds>(now - last);
+	// The first frame is measured from when the window was first shown
+	if (!this->frameMeasured) {
+		this->lastFrame = now;
+		this->frameMeasured = true;
+	}
+
+    auto dur = duration_cast<nanoseconds>(now - this->lastFrame);
 	this->lastFrameTime = dur.count() / 1e9;
-	last = now;
+	this->lastFrame = now;
 }
 
 double xr::Window::getLastFrameTime()
@@ -55,6 +65,11 @@ double xr::Window::getLastFrameTime()
 }
 
 
+GLFWwindow * xr::Window::getHandle()
+{
+	return this->glfwHandle;
+}
+
 int xr::Window::getWidth() {
 	return size.x;
 }
@@ -107,9 +122,10 @@ void xr::Window::setFullscreen(bool fullscreen)
 	}
 
 	glfwSetWindowMonitor(this->glfwHandle, monitor, x, y, width, height, GLFW_DONT_CARE);
-    glViewport(0, 0, width, height);
-
-	glfwSwapInterval(this->verticalSync);
+	if (this->isContextCurrent()) {
+		GLState::get().setViewport(0, 0, width, height);
+		glfwSwapInterval(this->verticalSync);
+	}
     this->size = { width, height };
 }
 
@@ -126,7 +142,9 @@ bool xr::Window::getFullscreen()
 void xr::Window::setVerticalSync(bool vsync)
 {
 	this->verticalSync = vsync;
-	glfwSwapInterval(vsync);
+	if (this->isContextCurrent()) {
+		glfwSwapInterval(vsync);
+	}
 }
 
 bool xr::Window::getVerticalSync()
@@ -217,6 +235,11 @@ void xr::Window::loadGL()
 	xr::loadOpenGL();
 }
 
+bool xr::Window::isContextCurrent()
+{
+	return glfwGetCurrentContext() == this->glfwHandle;
+}
+
 void xr::Window::setup(WindowPreferences preferences)
 {
 	// Callbacks
@@ -238,7 +261,7 @@ void xr::Window::setup(WindowPreferences preferences)
 
 	// Enable transparency
 	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	GLState::get().setBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 }
 
 
@@ -312,7 +335,9 @@ void xr::Window::keyCallback(GLFWwindow * window, int key, int scancode, int act
 void xr::Window::sizeCallback(GLFWwindow * window, int width, int height)
 {
 	if (Window* wnd = getWindow(window)) {
-		glViewport(0, 0, width, height);
+		if (wnd->isContextCurrent()) {
+			GLState::get().setViewport(0, 0, width, height);
+		}
 
 		wnd->size.x = width;
 		wnd->size.y = height;